@@ -0,0 +1,99 @@
+#include "book_stats.h"
+
+#include <algorithm>
+#include <immintrin.h>
+#include <limits>
+
+namespace ozma {
+
+namespace {
+
+static_assert(sizeof(Order) == 2 * sizeof(float) && sizeof(DepthLevel) == 2 * sizeof(float));
+static_assert(BookStats::maxDepth % 4 == 0);
+
+constexpr float NaN = std::numeric_limits<float>::quiet_NaN();
+
+uint32_t depthScalar(const Orders& orders, DepthLevel* depth) {
+    const size_t levels = std::min(orders.size(), BookStats::maxDepth);
+    DepthLevel sum;
+    for (size_t i = 0; i < levels; i++) {
+        sum.size += orders[i].size;
+        sum.notional += orders[i].price * orders[i].size;
+        depth[i] = sum;
+    }
+    return static_cast<uint32_t>(levels);
+}
+
+// [p0 s0 p1 s1 p2 s2 p3 s3] -> [s0 n0 s1 n1 s2 n2 s3 n3] prefix-summed pairwise plus carry
+inline __m256 depth4(__m256 levels, __m256 carry) {
+    const __m256 swapped = _mm256_permute_ps(levels, 0b10110001);
+    const __m256 product = _mm256_mul_ps(levels, swapped);
+    __m256 x = _mm256_blend_ps(swapped, product, 0b10101010);
+    // within 128-bit lanes: pair 1 += pair 0
+    x = _mm256_add_ps(x, _mm256_castsi256_ps(_mm256_slli_si256(_mm256_castps_si256(x), 8)));
+    // high lane += last pair of the low lane
+    const __m256 lowLast = _mm256_permute_ps(x, 0b11101110);
+    x = _mm256_add_ps(x, _mm256_permute2f128_ps(lowLast, lowLast, 0x08));
+    return _mm256_add_ps(x, carry);
+}
+
+uint32_t depthAvx(const Orders& orders, DepthLevel* depth) {
+    const size_t levels = std::min(orders.size(), BookStats::maxDepth);
+    const float* in = reinterpret_cast<const float*>(orders.data());
+    float* out = reinterpret_cast<float*>(depth);
+
+    __m256 carry = _mm256_setzero_ps();
+    size_t i = 0;
+    for (; i + 4 <= levels; i += 4) {
+        const __m256 x = depth4(_mm256_loadu_ps(in + 2 * i), carry);
+        _mm256_store_ps(out + 2 * i, x);
+        // last pair to every pair
+        const __m256 last = _mm256_permute_ps(x, 0b11101110);
+        carry = _mm256_permute2f128_ps(last, last, 0x11);
+    }
+    if (i < levels) {
+        const int tail = static_cast<int>(2 * (levels - i));
+        const __m256i mask = _mm256_cmpgt_epi32(
+            _mm256_set1_epi32(tail), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7));
+        // depth arrays are padded to 4 levels, the whole vector can be stored
+        _mm256_store_ps(out + 2 * i, depth4(_mm256_maskload_ps(in + 2 * i, mask), carry));
+    }
+    return static_cast<uint32_t>(levels);
+}
+
+DepthLevel topDepth(const DepthLevel* depth, uint32_t levels, size_t topN) {
+    if (levels == 0) {
+        return DepthLevel{ NaN, NaN };
+    }
+    return depth[std::clamp<size_t>(topN, 1, levels) - 1];
+}
+
+// Everything else comes from the first levels and the cumulative depth
+void finish(const BTCUSDT& btc, size_t topN, BookStats& stats) {
+    const float bestAsk = stats.askLevels > 0 ? btc.asks[0].price : NaN;
+    const float bestBid = stats.bidLevels > 0 ? btc.bids[0].price : NaN;
+    stats.mid = (bestAsk + bestBid) / 2;
+    stats.spread = bestAsk - bestBid;
+
+    const DepthLevel ask = topDepth(stats.askDepth, stats.askLevels, topN);
+    const DepthLevel bid = topDepth(stats.bidDepth, stats.bidLevels, topN);
+    stats.askVwap = ask.notional / ask.size;
+    stats.bidVwap = bid.notional / bid.size;
+    stats.imbalance = (bid.size - ask.size) / (bid.size + ask.size);
+}
+
+}   // namespace
+
+void computeStats(const BTCUSDT& btc, size_t topN, BookStats& stats) {
+    stats.askLevels = depthScalar(btc.asks, stats.askDepth);
+    stats.bidLevels = depthScalar(btc.bids, stats.bidDepth);
+    finish(btc, topN, stats);
+}
+
+void computeStatsAvx(const BTCUSDT& btc, size_t topN, BookStats& stats) {
+    stats.askLevels = depthAvx(btc.asks, stats.askDepth);
+    stats.bidLevels = depthAvx(btc.bids, stats.bidDepth);
+    finish(btc, topN, stats);
+}
+
+}   // namespace ozma
@@ -0,0 +1,43 @@
+#pragma once
+
+#include "parser.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ozma {
+
+// Cumulative values up to and including a level
+struct DepthLevel {
+    float size{};
+    // sum of price * size
+    float notional{};
+};
+
+// Statistics of the levels of one update. Sides are taken in the order the exchange sends
+// them: best price first. Values of an empty side are NaN.
+struct BookStats {
+    // Levels per side the depth is kept for, the rest are ignored
+    constexpr static size_t maxDepth = 64;
+
+    float mid{};
+    float spread{};
+    // Over the top n levels
+    float askVwap{};
+    float bidVwap{};
+    // (bid size - ask size) / (bid size + ask size) over the top n levels
+    float imbalance{};
+
+    uint32_t askLevels{};
+    uint32_t bidLevels{};
+    alignas(32) DepthLevel askDepth[maxDepth];
+    alignas(32) DepthLevel bidDepth[maxDepth];
+};
+
+// Reference version, plain loops
+void computeStats(const BTCUSDT& btc, size_t topN, BookStats& stats);
+
+// Same in one AVX2 pass per side: 4 levels at a time, prefix sums of size and price * size
+void computeStatsAvx(const BTCUSDT& btc, size_t topN, BookStats& stats);
+
+}   // namespace ozma
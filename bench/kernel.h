@@ -0,0 +1,104 @@
+#pragma once
+
+#include "benchmark.h"
+#include "common.h"
+
+#include "hdr_histogram/include/hdr/hdr_histogram.h"
+
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace ozma::bench {
+
+struct HdrDeleter {
+    void operator()(hdr_histogram* h) const {
+        hdr_close(h);
+    }
+};
+using Histogram = std::unique_ptr<hdr_histogram, HdrDeleter>;
+
+// 1ns..10ms to start: wider than the runtime benchmark, slow readers hit page faults.
+// Slower values grow it like the runtime benchmark's.
+inline Histogram makeHistogram() {
+    hdr_histogram* h = nullptr;
+    REQUIRE(hdr_init(1, 10'000'000, 3, &h) == 0, "Can't create histogram");
+    return Histogram(h);
+}
+
+// benchmark::recordGrowing/addGrowing for an owned histogram
+inline void recordGrowing(Histogram& histogram, int64_t value) {
+    hdr_histogram* h = histogram.get();
+    benchmark::recordGrowing(h, value);
+    if (h != histogram.get()) {
+        // The old one is closed already
+        histogram.release();
+        histogram.reset(h);
+    }
+}
+
+inline void addGrowing(Histogram& histogram, const hdr_histogram* from) {
+    hdr_histogram* h = histogram.get();
+    benchmark::addGrowing(h, from);
+    if (h != histogram.get()) {
+        histogram.release();
+        histogram.reset(h);
+    }
+}
+
+template <typename T>
+inline void doNotOptimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+struct KernelResult {
+    std::string name;
+    // Per repetition, ns
+    std::vector<double> p50;
+    std::vector<double> p99;
+    // All repetitions together
+    Histogram histogram;
+};
+
+// Times single calls of a kernel within one repetition
+class Recorder {
+public:
+    explicit Recorder(Histogram& histogram)
+        : histogram_(histogram) {
+    }
+
+    template <typename Fn>
+    void time(Fn&& fn) {
+        const auto start = TimePoint::clock::now();
+        fn();
+        const auto elapsed =
+            std::chrono::duration_cast<std::chrono::nanoseconds>(TimePoint::clock::now() - start)
+                .count();
+        recordGrowing(histogram_, elapsed);
+    }
+
+private:
+    Histogram& histogram_;
+};
+
+// body(Recorder&) is one repetition, it calls Recorder::time for each measured call
+template <typename Body>
+KernelResult runKernel(const std::string& name, size_t repetitions, Body&& body) {
+    KernelResult result{ name, {}, {}, makeHistogram() };
+    auto rep = makeHistogram();
+    for (size_t i = 0; i < repetitions; i++) {
+        hdr_reset(rep.get());
+        Recorder recorder(rep);
+        body(recorder);
+        if (rep->total_count == 0) {
+            continue;
+        }
+        result.p50.push_back(static_cast<double>(hdr_value_at_percentile(rep.get(), 50.0)));
+        result.p99.push_back(static_cast<double>(hdr_value_at_percentile(rep.get(), 99.0)));
+        addGrowing(result.histogram, rep.get());
+    }
+    return result;
+}
+
+}   // namespace ozma::bench
@@ -0,0 +1,259 @@
+#include "kernel.h"
+#include "report.h"
+
+#include "csv_row.h"
+#include "lazy_view.h"
+#include "mapped_file.h"
+#include "parser.h"
+#include "reader.h"
+#include "simd.h"
+
+#include "utils/common.h"
+#include "utils/logger.h"
+
+#include <boost/program_options.hpp>
+
+#include <charconv>
+#include <fstream>
+#include <iomanip>
+
+// Kernel-level benchmarks: simd conversion, row scan, each reader and each parser timed
+// per call over repetitions. Results go to json, --baseline compares against a stored run.
+
+namespace opt = boost::program_options;
+
+namespace {
+
+using namespace ozma;
+using namespace ozma::bench;
+
+struct Options {
+    std::string filePath = "./csv/data.csv";
+    size_t repetitions = 15;
+    // Rows per repetition
+    size_t rows = 20'000;
+    std::string filter;
+    std::string outPath;
+    std::string baselinePath;
+    double threshold = 0.05;
+    double alpha = 0.01;
+};
+
+struct CharsetBlock {
+    alignas(64) std::array<Charset, 256> chars;
+    size_t size = 0;
+};
+
+struct Samples {
+    std::vector<std::string> plain;
+    std::vector<std::string> escaped;
+    std::vector<int32_t> ids;
+    // Levels of the escaped messages as the avx parser feeds them to the kernel
+    std::vector<CharsetBlock> charsets;
+};
+
+void appendCharset(CharsetBlock& block, float value, int precision) {
+    char buffer[32];
+    auto [end, ec] =
+        std::to_chars(buffer, buffer + sizeof(buffer), value, std::chars_format::fixed, precision);
+    UNUSED(ec);
+    fillCharset(block.chars[block.size++], buffer, end - buffer);
+}
+
+Samples loadSamples(const Options& options) {
+    Samples samples;
+    Reader<Fastcsv> plain(options.filePath);
+    while (plain.valid() && samples.plain.size() < options.rows) {
+        if (auto data = plain.readLine()) {
+            samples.plain.push_back(std::move(*data));
+        }
+    }
+
+    Reader<Mmap> escaped(options.filePath);
+    CustomParser parser;
+    while (escaped.valid() && samples.escaped.size() < options.rows) {
+        auto data = escaped.readLine();
+        if (!data) {
+            continue;
+        }
+        samples.escaped.emplace_back(*data);
+        samples.ids.push_back(escaped.id());
+
+        const auto& btc = parser.parseEscaped(*data);
+        CharsetBlock& block = samples.charsets.emplace_back();
+        for (const auto* side : { &btc.asks, &btc.bids }) {
+            for (const auto& order : *side) {
+                if (block.size + 2 > block.chars.size()) {
+                    break;
+                }
+                appendCharset(block, order.price, 2);
+                appendCharset(block, order.size, 3);
+            }
+        }
+    }
+    REQUIRE(!samples.escaped.empty(), "No BTCUSDT rows in " << options.filePath);
+    return samples;
+}
+
+template <typename ReaderT>
+void readRows(const Options& options, Recorder& recorder) {
+    ReaderT reader(options.filePath);
+    for (size_t row = 0; row < options.rows && reader.valid(); row++) {
+        recorder.time([&] { doNotOptimize(reader.readLine()); });
+    }
+}
+
+template <typename Parser>
+void parsePlain(Parser& parser, const Samples& samples, Recorder& recorder) {
+    for (const auto& message : samples.plain) {
+        recorder.time([&] { doNotOptimize(parser.parse(message)); });
+    }
+}
+
+template <typename Parser>
+void parseEscaped(Parser& parser, const Samples& samples, Recorder& recorder) {
+    for (const auto& message : samples.escaped) {
+        recorder.time([&] { doNotOptimize(parser.parseEscaped(message)); });
+    }
+}
+
+std::vector<KernelResult> runAll(const Options& options, const Samples& samples) {
+    std::vector<KernelResult> results;
+    auto add = [&](const std::string& name, auto&& body) {
+        if (name.find(options.filter) == std::string::npos) {
+            return;
+        }
+        INFO() << "Running " << name;
+        results.push_back(runKernel(name, options.repetitions, body));
+    };
+
+    // The kernel takes the charsets by non-const reference
+    auto charsets = samples.charsets;
+    add("simd/parseCharsToFloatsAvx", [&](Recorder& recorder) {
+        for (auto& block : charsets) {
+            recorder.time([&] { doNotOptimize(parseCharsToFloatsAvx(block.chars, block.size)); });
+        }
+    });
+
+    add("scan/findRowEnd", [&](Recorder& recorder) {
+        MappedFile file(options.filePath);
+        const char* pos = file.data();
+        for (size_t row = 0; row < options.rows && pos != nullptr && pos < file.end(); row++) {
+            recorder.time([&] { pos = findRowEnd(pos, file.end()); });
+        }
+    });
+
+    add("reader/Fastcsv", [&](Recorder& recorder) { readRows<Reader<Fastcsv>>(options, recorder); });
+    add("reader/Vinces", [&](Recorder& recorder) { readRows<Reader<Vinces>>(options, recorder); });
+    add("reader/Rapidcsv",
+        [&](Recorder& recorder) { readRows<Reader<Rapidcsv>>(options, recorder); });
+    add("reader/Mmap", [&](Recorder& recorder) { readRows<Reader<Mmap>>(options, recorder); });
+    add("reader/Stream", [&](Recorder& recorder) { readRows<Reader<Stream>>(options, recorder); });
+
+    NlohmannJsonParser nlohmannJsonParser;
+    SimdJsonParser simdJsonParser;
+    CustomParser customParser;
+    CustomAvxParser customAvxParser;
+    FingerprintParser fingerprintParser;
+    add("parser/NlohmannJson",
+        [&](Recorder& recorder) { parsePlain(nlohmannJsonParser, samples, recorder); });
+    add("parser/SimdJson",
+        [&](Recorder& recorder) { parsePlain(simdJsonParser, samples, recorder); });
+    add("parser/Custom", [&](Recorder& recorder) { parsePlain(customParser, samples, recorder); });
+    add("parser/CustomAvx",
+        [&](Recorder& recorder) { parsePlain(customAvxParser, samples, recorder); });
+    add("parser/CustomEscaped",
+        [&](Recorder& recorder) { parseEscaped(customParser, samples, recorder); });
+    add("parser/CustomAvxEscaped",
+        [&](Recorder& recorder) { parseEscaped(customAvxParser, samples, recorder); });
+    add("parser/FingerprintEscaped", [&](Recorder& recorder) {
+        for (size_t i = 0; i < samples.escaped.size(); i++) {
+            recorder.time([&] {
+                doNotOptimize(fingerprintParser.parseEscaped(samples.escaped[i], samples.ids[i]));
+            });
+        }
+    });
+    add("parser/LazyTopEscaped", [&](Recorder& recorder) {
+        for (const auto& message : samples.escaped) {
+            recorder.time([&] {
+                auto view = BTCUSDTView::fromEscaped(message);
+                doNotOptimize(view.asks().top(5));
+                doNotOptimize(view.bids().top(5));
+            });
+        }
+    });
+    return results;
+}
+
+}   // namespace
+
+int main(int argc, char* argv[]) try {
+    INIT_LOGGER({ ozma::Logger::Out::Stdout });
+
+    opt::options_description desc("all options");
+    opt::variables_map vm;
+
+    Options options;
+    desc.add_options()("help,h", "Show help")(
+        "file,f", opt::value(&options.filePath)->default_value(options.filePath), "Csv file")(
+        "repetitions",
+        opt::value(&options.repetitions)->default_value(options.repetitions),
+        "Repetitions per kernel, the baseline comparison is over their p50/p99")(
+        "rows",
+        opt::value(&options.rows)->default_value(options.rows),
+        "Rows (or messages) per repetition")(
+        "filter", opt::value(&options.filter), "Only kernels whose name contains this")(
+        "out,o", opt::value(&options.outPath), "Write results as json")(
+        "baseline", opt::value(&options.baselinePath), "Compare against a stored json result")(
+        "threshold",
+        opt::value(&options.threshold)->default_value(options.threshold),
+        "Allowed p50/p99 slowdown against the baseline, 0.05 is 5%")(
+        "alpha",
+        opt::value(&options.alpha)->default_value(options.alpha),
+        "Significance level of the Mann-Whitney test");
+
+    opt::store(opt::parse_command_line(argc, argv, desc), vm);
+    opt::notify(vm);
+
+    if (vm.contains("help")) {
+        INFO() << desc;
+        return EXIT_SUCCESS;
+    }
+
+    const auto samples = loadSamples(options);
+    const auto results = runAll(options, samples);
+    for (const auto& result : results) {
+        INFO() << std::left << std::setw(28) << result.name
+               << " p50: " << hdr_value_at_percentile(result.histogram.get(), 50.0)
+               << " p99: " << hdr_value_at_percentile(result.histogram.get(), 99.0)
+               << " count: " << result.histogram->total_count;
+    }
+
+    if (!options.outPath.empty()) {
+        std::ofstream out(options.outPath);
+        REQUIRE(out, "Can't write " << options.outPath);
+        out << toJson(results).dump(2) << "\n";
+        INFO() << "Results written to " << options.outPath;
+    }
+
+    size_t regressions = 0;
+    if (!options.baselinePath.empty()) {
+        std::ifstream in(options.baselinePath);
+        REQUIRE(in, "Can't read " << options.baselinePath);
+        nlohmann::json baseline;
+        in >> baseline;
+        for (const auto& c : compare(baseline, results, options.threshold, options.alpha)) {
+            INFO() << (c.regressed ? "REGRESSION " : "") << c.kernel << " " << c.metric << ": "
+                   << c.baseline << " -> " << c.current << " ns (" << std::showpos
+                   << c.change * 100 << std::noshowpos << "%, p = " << c.p << ")";
+            regressions += c.regressed;
+        }
+        INFO() << regressions << " regressions against " << options.baselinePath;
+    }
+
+    ozma::Logger::waitLogThread();
+    return regressions == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+} catch (std::exception& ex) {
+    ERROR() << ex.what();
+    return EXIT_FAILURE;
+}
@@ -0,0 +1,82 @@
+#include "report.h"
+#include "stats.h"
+
+#include "hdr_histogram/include/hdr/hdr_histogram_log.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <utility>
+
+namespace ozma::bench {
+
+namespace {
+
+std::string encode(hdr_histogram* histogram) {
+    char* encoded = nullptr;
+    const int rc = hdr_log_encode(histogram, &encoded);
+    REQUIRE(rc == 0, "Can't encode histogram: " << hdr_strerror(rc));
+    std::string result(encoded);
+    std::free(encoded);
+    return result;
+}
+
+}   // namespace
+
+nlohmann::json toJson(const std::vector<KernelResult>& results) {
+    nlohmann::json kernels = nlohmann::json::array();
+    for (const auto& result : results) {
+        hdr_histogram* h = result.histogram.get();
+        nlohmann::json kernel;
+        kernel["name"] = result.name;
+        kernel["count"] = h->total_count;
+        kernel["mean"] = hdr_mean(h);
+        kernel["p50"] = hdr_value_at_percentile(h, 50.0);
+        kernel["p90"] = hdr_value_at_percentile(h, 90.0);
+        kernel["p99"] = hdr_value_at_percentile(h, 99.0);
+        kernel["p999"] = hdr_value_at_percentile(h, 99.9);
+        kernel["max"] = hdr_max(h);
+        kernel["hdr"] = encode(h);
+        kernel["repetitions"]["p50"] = result.p50;
+        kernel["repetitions"]["p99"] = result.p99;
+        kernels.push_back(kernel);
+    }
+    nlohmann::json report;
+    report["unit"] = "ns";
+    report["kernels"] = kernels;
+    return report;
+}
+
+std::vector<Comparison> compare(
+    const nlohmann::json& baseline,
+    const std::vector<KernelResult>& results,
+    double threshold,
+    double alpha) {
+    std::vector<Comparison> comparisons;
+    for (const auto& result : results) {
+        auto base = std::find_if(
+            baseline.at("kernels").begin(),
+            baseline.at("kernels").end(),
+            [&](const nlohmann::json& kernel) { return kernel.at("name") == result.name; });
+        if (base == baseline.at("kernels").end()) {
+            continue;
+        }
+        for (const auto& [metric, current] :
+             { std::pair{ "p50", &result.p50 }, std::pair{ "p99", &result.p99 } }) {
+            const auto before = base->at("repetitions").at(metric).get<std::vector<double>>();
+            Comparison comparison;
+            comparison.kernel = result.name;
+            comparison.metric = metric;
+            comparison.baseline = median(before);
+            comparison.current = median(*current);
+            comparison.change = comparison.baseline > 0
+                                    ? comparison.current / comparison.baseline - 1
+                                    : 0;
+            comparison.p = mannWhitneyP(before, *current);
+            comparison.regressed = comparison.change > threshold && comparison.p < alpha;
+            comparisons.push_back(comparison);
+        }
+    }
+    return comparisons;
+}
+
+}   // namespace ozma::bench
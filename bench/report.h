@@ -0,0 +1,37 @@
+#pragma once
+
+#include "kernel.h"
+
+#include "nlohmann/json.hpp"
+
+#include <string>
+#include <vector>
+
+namespace ozma::bench {
+
+// Per kernel: percentiles over all repetitions, the full histogram (hdr_log_encode: compressed,
+// base64) and the per-repetition p50/p99 the baseline comparison works on
+nlohmann::json toJson(const std::vector<KernelResult>& results);
+
+struct Comparison {
+    std::string kernel;
+    // "p50" or "p99"
+    std::string metric;
+    // Medians over the repetitions, ns
+    double baseline{};
+    double current{};
+    // current / baseline - 1
+    double change{};
+    // Mann-Whitney over the repetitions
+    double p{};
+    bool regressed{};
+};
+
+// Kernels present in both. Regressed: slower by more than threshold and significant (p < alpha)
+std::vector<Comparison> compare(
+    const nlohmann::json& baseline,
+    const std::vector<KernelResult>& results,
+    double threshold,
+    double alpha);
+
+}   // namespace ozma::bench
@@ -0,0 +1,71 @@
+#include "stats.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <utility>
+
+namespace ozma::bench {
+
+double median(std::vector<double> values) {
+    if (values.empty()) {
+        return 0;
+    }
+    const size_t mid = values.size() / 2;
+    std::nth_element(values.begin(), values.begin() + mid, values.end());
+    if (values.size() % 2 == 1) {
+        return values[mid];
+    }
+    return (values[mid] + *std::max_element(values.begin(), values.begin() + mid)) / 2;
+}
+
+double mannWhitneyP(const std::vector<double>& a, const std::vector<double>& b) {
+    const double n1 = static_cast<double>(a.size());
+    const double n2 = static_cast<double>(b.size());
+    if (a.empty() || b.empty()) {
+        return 1;
+    }
+
+    // (value, from a)
+    std::vector<std::pair<double, bool>> all;
+    all.reserve(a.size() + b.size());
+    for (double v : a) {
+        all.emplace_back(v, true);
+    }
+    for (double v : b) {
+        all.emplace_back(v, false);
+    }
+    std::sort(all.begin(), all.end());
+
+    // Ties get the average rank
+    double rankSumA = 0;
+    double tieTerm = 0;
+    for (size_t i = 0; i < all.size();) {
+        size_t j = i;
+        while (j < all.size() && all[j].first == all[i].first) {
+            j++;
+        }
+        const double rank = (static_cast<double>(i + j) + 1) / 2;
+        const double ties = static_cast<double>(j - i);
+        tieTerm += ties * ties * ties - ties;
+        for (size_t k = i; k < j; k++) {
+            if (all[k].second) {
+                rankSumA += rank;
+            }
+        }
+        i = j;
+    }
+
+    const double n = n1 + n2;
+    const double u = rankSumA - n1 * (n1 + 1) / 2;
+    const double mean = n1 * n2 / 2;
+    const double sigma = std::sqrt(n1 * n2 / 12 * ((n + 1) - tieTerm / (n * (n - 1))));
+    if (sigma == 0) {
+        return 1;
+    }
+    // Continuity correction
+    const double z = std::max(0.0, std::abs(u - mean) - 0.5) / sigma;
+    return std::erfc(z / std::sqrt(2.0));
+}
+
+}   // namespace ozma::bench
@@ -0,0 +1,13 @@
+#pragma once
+
+#include <vector>
+
+namespace ozma::bench {
+
+double median(std::vector<double> values);
+
+// Two-sided p-value of the Mann-Whitney U test (normal approximation with tie correction):
+// how likely both samples come from the same distribution
+double mannWhitneyP(const std::vector<double>& a, const std::vector<double>& b);
+
+}   // namespace ozma::bench
@@ -3,16 +3,30 @@
 #include "common.h"
 #include "logger.h"
 #include "parser.h"
+#include "lazy_view.h"
+#include "merge_reader.h"
+#include "batch.h"
+#include "book_stats.h"
+#include "checkpoint.h"
 #include "benchmark.h"
+#include "reader.h"
+#include "shm_ring.h"
+#include "sparse_index.h"
+#include "topology.h"
+#include "trace.h"
 
 #include <sched.h>
-#include "fastcsv/csv.h"
-
-#include "rapidcsv/src/rapidcsv.h"
-
-#include "vinces/single_include/csv.hpp"
+#include <signal.h>
+#include <sys/eventfd.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <atomic>
+#include <cerrno>
 #include <chrono>
+#include <cstring>
+#include <limits>
 #include <thread>
+#include <memory>
 #include <optional>
 #include <stdexcept>
 
@@ -20,14 +34,13 @@ namespace ozma {
 
 namespace {
 
-void setThreadAffinity() {
-    cpu_set_t cpuset;
-    CPU_ZERO(&cpuset);
-    CPU_SET(std::thread::hardware_concurrency() - 1, &cpuset);
-    pthread_t currentThread = pthread_self();
-    if (pthread_setaffinity_np(currentThread, sizeof(cpu_set_t), &cpuset)) {
-        throw std::runtime_error{ "pthread_setaffinity_np error" };
+// Last cpu unless configured
+Placement mainPlacement(const LaunchOptions& options) {
+    if (options.mainCpus.empty()) {
+        return Placement{ { static_cast<int>(std::thread::hardware_concurrency()) - 1 },
+                          options.numaNode };
     }
+    return Placement::parse(options.mainCpus, options.numaNode);
 }
 
 void setThreadPriority() {
@@ -35,227 +48,663 @@ void setThreadPriority() {
     sched_param schParams;
     schParams.sched_priority = sched_get_priority_max(SCHED_RR);
     if (pthread_setschedparam(currentThread, SCHED_RR, &schParams)) {
-        throw std::runtime_error{ "pthread_setschedparam error" };
+        WARN() << "Can't set SCHED_RR (no real-time privileges?), running with default policy";
     }
 }
 
 void lockMemory() {
     if (mlockall(MCL_CURRENT | MCL_FUTURE)) {
-        throw std::runtime_error{ "mlockall error" };
+        WARN() << "Can't mlockall (RLIMIT_MEMLOCK?), page faults may show in the results";
     }
 }
 
-void prepare() {
-    setThreadAffinity();
+void prepare(const LaunchOptions& options) {
+    INFO() << "Topology: " << CpuTopology::get().describe();
+    if (!options.loggerCpus.empty()) {
+        auto logger = Placement::parse(options.loggerCpus);
+        if (!pinThread(Logger::getLogThread().native_handle(), logger.cpus)) {
+            WARN() << "Can't pin the logger thread";
+        }
+    }
+    applyPlacement(mainPlacement(options), "main");
     setThreadPriority();
     lockMemory();
 }
 
-const std::string FILE_PATH = "./csv/data.csv";
-
-using Fastcsv = io::CSVReader<4, io::trim_chars<' ', '\t'>, io::double_quote_escape<',', '\"'>>;
-using Rapidcsv = rapidcsv::Document;
-using Vinces = csv::CSVReader;
+enum class ReaderType { Fastcsv, Rapidcsv, Vinces, Mmap, Stream, Merge };
+DECLARE_ENUM(ReaderType, 6, Fastcsv, Rapidcsv, Vinces, Mmap, Stream, Merge);
+
+enum class ParserType {
+    NlohmannJson,
+    SimdJson,
+    Custom,
+    CustomAvx,
+    CustomEscaped,
+    CustomAvxEscaped,
+    LazyTopEscaped,
+    CustomAvxBatch,
+    FingerprintEscaped
+};
+DECLARE_ENUM(
+    ParserType,
+    9,
+    NlohmannJson,
+    SimdJson,
+    Custom,
+    CustomAvx,
+    CustomEscaped,
+    CustomAvxEscaped,
+    LazyTopEscaped,
+    CustomAvxBatch,
+    FingerprintEscaped);
+
+enum class LatencyType { ArrivalToParsed };
+DECLARE_ENUM(LatencyType, 1, ArrivalToParsed);
+
+enum class BookType { Apply, Checkpoint };
+DECLARE_ENUM(BookType, 2, Apply, Checkpoint);
+
+enum class AnalyticsType { Scalar, Avx };
+DECLARE_ENUM(AnalyticsType, 2, Scalar, Avx);
+
+enum class SinkType { ShmRing };
+DECLARE_ENUM(SinkType, 1, ShmRing);
+
+// Levels a top-of-book consumer looks at
+const size_t TOP_LEVELS = 5;
+
+// Batch mode: messages per batch and arena for their levels
+const size_t BATCH_SIZE = 256;
+const size_t BATCH_ARENA_BYTES = 4 << 20;
+
+// Readers and parsers skipped in the current mode have nothing to print
+#define PRINT_DISTR(BenchType, BenchName)                                                          \
+    if (BENCH_RECORDED(BenchType, BenchName)) {                                                    \
+        INFO() << BENCH_DISTR(BenchType, BenchName);                                               \
+    }
 
-enum class ReaderType { Fastcsv, Rapidcsv, Vinces };
-DECLARE_ENUM(ReaderType, 3, Fastcsv, Rapidcsv, Vinces);
+std::unique_ptr<ShmRingPublisher> makeShmRing(const LaunchOptions& options) {
+    if (options.shmRing.empty()) {
+        return nullptr;
+    }
+    INFO() << "Publishing to shm ring " << options.shmRing;
+    return std::make_unique<ShmRingPublisher>(
+        options.shmRing, options.shmCapacity, options.shmNode);
+}
 
-enum class ParserType { NlohmannJson, SimdJson, Custom, CustomAvx };
-DECLARE_ENUM(ParserType, 4, NlohmannJson, SimdJson, Custom, CustomAvx);
+// Written by the signal handler, polled by the live reader along with its source.
+// -1 outside of launchLive.
+std::atomic<int> stopFd{ -1 };
 
-template <typename ReaderT>
-class Reader;
+void onStopSignal(int) {
+    const int fd = stopFd.load();
+    if (fd < 0) {
+        return;
+    }
+    const uint64_t one = 1;
+    [[maybe_unused]] const auto res = write(fd, &one, sizeof(one));
+}
 
-template <>
-class Reader<Fastcsv> {
+// SIGINT/SIGTERM write to stopFd while it lives. The previous handlers come back before
+// the fd is closed: a late signal can't hit a file that reuses the number.
+class StopSignals {
 public:
-    Reader()
-        : reader_(FILE_PATH) {
+    StopSignals() {
+        const int fd = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+        REQUIRE(fd != -1, "Can't create eventfd: " << std::strerror(errno));
+        stopFd = fd;
+        struct sigaction action {};
+        action.sa_handler = onStopSignal;
+        sigaction(SIGINT, &action, &prevInt_);
+        sigaction(SIGTERM, &action, &prevTerm_);
     }
 
-    std::optional<std::string> readLine() { 
-        valid_ = reader_.read_row(body_, id_, b1_, b2_);
-        if (valid_ && (id_ == BTCUSDT::iD1 || id_ == BTCUSDT::iD2)) {
-            return std::optional<std::string>{std::move(body_)};
-        }
-        return std::nullopt;
+    ~StopSignals() {
+        sigaction(SIGINT, &prevInt_, nullptr);
+        sigaction(SIGTERM, &prevTerm_, nullptr);
+        close(stopFd.exchange(-1));
     }
 
-    bool valid() const {
-        return valid_;
+    StopSignals(const StopSignals&) = delete;
+    StopSignals& operator=(const StopSignals&) = delete;
+
+    int fd() const {
+        return stopFd.load();
     }
 
 private:
-    Fastcsv reader_;
-    std::string body_;
-    int32_t id_, b1_, b2_;
-    bool valid_ = true;
+    struct sigaction prevInt_ {};
+    struct sigaction prevTerm_ {};
 };
 
-template <>
-class Reader<Rapidcsv> {
-private:
-    const static inline size_t DATA_COL = 0;
-    const static inline size_t ID_COL = 1;
+// Parses rows as they arrive until the source is closed or SIGINT/SIGTERM.
+// The same escaped-input parsers as the Mmap reader run on every row, the update of
+// CustomAvxEscaped is the one published and timed from arrival.
+void launchLive(const LaunchOptions& options) {
+    // Any thread may take the signal, the eventfd wakes the reader wherever it waits
+    std::optional<StopSignals> stopSignals(std::in_place);
+    TailReader reader(
+        *options.liveSource, options.livePath, options.liveFromStart, stopSignals->fd());
+    CustomParser customParser;
+    CustomAvxParser customAvxParser;
+    FingerprintParser fingerprintParser;
+    auto shmRing = makeShmRing(options);
+    size_t messages = 0;
+    for (; reader.valid();) {
+        auto data = reader.readLine();
+        if (data) {
+            // The read itself is mostly waiting for the source, not traced
+            TraceRecord* trace = Tracer::begin(messages);
+            BENCH_START(ParserType, CustomAvxEscaped);
+            const auto& btc5 = customAvxParser.parseEscaped(*data);
+            BENCH_END(ParserType, CustomAvxEscaped);
+            Tracer::mark(trace, TraceStage::Parse);
+            //INFO() << btc5;
+
+            if (shmRing) {
+                BENCH_START(SinkType, ShmRing);
+                shmRing->publish(btc5.t, btc5.u, btc5.asks, btc5.bids);
+                BENCH_END(SinkType, ShmRing);
+                Tracer::mark(trace, TraceStage::Publish);
+            }
 
-public:
-    Reader()
-        : reader_(FILE_PATH)
-        , lines_(reader_.GetRowCount())
-        , line_(0) {
+            BENCH_RECORD(
+                LatencyType,
+                ArrivalToParsed,
+                std::chrono::duration_cast<std::chrono::nanoseconds>(
+                    TimePoint::clock::now() - reader.arrival())
+                    .count());
+            messages++;
+
+            // The rest only competes with the next row, not with this one
+            BENCH_START(ParserType, CustomEscaped);
+            const auto& btc4 = customParser.parseEscaped(*data);
+            BENCH_END(ParserType, CustomEscaped);
+            UNUSED(btc4);
+
+            BENCH_START(ParserType, LazyTopEscaped);
+            auto view = BTCUSDTView::fromEscaped(*data);
+            auto topAsks = view.asks().top(TOP_LEVELS);
+            auto topBids = view.bids().top(TOP_LEVELS);
+            BENCH_END(ParserType, LazyTopEscaped);
+            UNUSED(topAsks);
+            UNUSED(topBids);
+
+            BENCH_START(ParserType, FingerprintEscaped);
+            const auto& btc6 = fingerprintParser.parseEscaped(*data, reader.id());
+            BENCH_END(ParserType, FingerprintEscaped);
+            UNUSED(btc6);
+        }
     }
+    INFO() << "Live source closed after " << messages << " messages";
+
+    stopSignals.reset();
 
-    std::optional<std::string> readLine() {
-        const auto id = reader_.GetCell<int32_t>(ID_COL, line_);
-        if (id == BTCUSDT::iD1 || id == BTCUSDT::iD2) {
-            return reader_.GetCell<std::string>(DATA_COL, line_++);
+    PRINT_DISTR(ParserType, CustomEscaped);
+    PRINT_DISTR(ParserType, CustomAvxEscaped);
+    PRINT_DISTR(ParserType, LazyTopEscaped);
+    PRINT_DISTR(ParserType, FingerprintEscaped);
+    PRINT_DISTR(LatencyType, ArrivalToParsed);
+    PRINT_DISTR(SinkType, ShmRing);
+}
+
+// Time-ordered replay of several files: parsed by a thread per file, merged on this one
+void launchMerge(const LaunchOptions& options) {
+    MergeReader reader(
+        options.mergePaths,
+        MergeReader::defaultQueueCapacity,
+        options.mergeCpus.empty() ? std::vector<int>{} : parseCpuList(options.mergeCpus),
+        mainPlacement(options).effectiveNode());
+    size_t messages = 0;
+    size_t disordered = 0;
+    Stamp last{ std::numeric_limits<int64_t>::min(), std::numeric_limits<int64_t>::min() };
+    const auto start = TimePoint::clock::now();
+    for (;;) {
+        BENCH_START(ReaderType, Merge);
+        const BTCUSDT* btc = reader.next();
+        BENCH_END(ReaderType, Merge);
+        if (btc == nullptr) {
+            break;
+        }
+        //INFO() << *btc;
+        if (btc->t < last.t || (btc->t == last.t && btc->u < last.u)) {
+            disordered++;
         }
-        line_++;
-        return std::nullopt;
+        last = Stamp{ btc->t, btc->u };
+        messages++;
     }
+    const auto elapsed = std::chrono::duration<double>(TimePoint::clock::now() - start).count();
+    INFO() << "Merged " << messages << " messages from " << options.mergePaths.size()
+           << " files in " << elapsed << " s, " << static_cast<int64_t>(messages / elapsed)
+           << " messages/s";
+    if (disordered > 0) {
+        WARN() << disordered << " messages out of order: some input is not ordered by (T, u)";
+    }
+
+    PRINT_DISTR(ReaderType, Merge);
+}
 
-    bool valid() const {
-        return line_ < lines_;
+// Replays the file into an order book, resuming from a checkpoint and writing new ones
+void launchBook(const LaunchOptions& options) {
+    // Restored: the prefix before the checkpoint is never read, don't fault it in
+    Reader<Mmap> reader(options.filePath, !options.restore);
+    OrderBook book;
+    if (options.restore) {
+        CheckpointStore store(options.filePath);
+        if (auto checkpoint = store.loadNearest(reader.file(), options.fromTime, options.fromSeq)) {
+            book = checkpoint->book;
+            reader.seek(IndexEntry{ checkpoint->offset, checkpoint->row, book.t(), book.u() });
+            INFO() << "Restored the book at u " << book.u() << ", T " << book.t() << ", row "
+                   << checkpoint->row;
+        } else {
+            INFO() << "No checkpoint to restore, replaying from the beginning";
+        }
     }
 
-private:
-    Rapidcsv reader_;
-    size_t lines_;
-    size_t line_;
+    std::optional<CheckpointWriter> writer;
+    if (options.checkpointEvery > 0) {
+        writer.emplace(options.filePath);
+    }
+    CustomAvxParser parser;
+    size_t messages = 0;
+    for (; reader.valid();) {
+        const uint64_t readBegin = Tracer::now();
+        auto data = reader.readLine();
+        if (!data) {
+            continue;
+        }
+        TraceRecord* trace = Tracer::begin(reader.row(), readBegin);
+        Tracer::mark(trace, TraceStage::Read);
+        const auto& btc = parser.parseEscaped(*data);
+        Tracer::mark(trace, TraceStage::Parse);
+        BENCH_START(BookType, Apply);
+        book.apply(btc);
+        BENCH_END(BookType, Apply);
+        Tracer::mark(trace, TraceStage::Book);
+        messages++;
+
+        if (writer && messages % options.checkpointEvery == 0) {
+            BENCH_START(BookType, Checkpoint);
+            writer->submit(book, reader.offset(), reader.row());
+            BENCH_END(BookType, Checkpoint);
+        }
+    }
+    INFO() << "Applied " << messages << " updates, book at u " << book.u() << ": "
+           << book.asks().size() << " asks, " << book.bids().size() << " bids";
+    if (writer) {
+        INFO() << "Checkpoints written: " << writer->written() << ", skipped while busy: "
+               << writer->skipped();
+    }
+
+    PRINT_DISTR(BookType, Apply);
+    PRINT_DISTR(BookType, Checkpoint);
+}
+
+}   // namespace
+
+// Writes the trace and the last histogram intervals when the run ends, whichever mode it was
+struct RunOutputs {
+    ~RunOutputs() {
+        try {
+            if (!tracePath.empty()) {
+                Tracer::writeChromeTrace(tracePath);
+            }
+            if (intervalLogs) {
+                benchmark::flushIntervalLogs();
+            }
+        } catch (std::exception& ex) {
+            ERROR() << ex.what();
+        }
+    }
+
+    std::string tracePath;
+    bool intervalLogs = false;
 };
 
-template <>
-class Reader<Vinces> {
-private:
-    const static inline size_t DATA_COL = 0;
-    const static inline size_t ID_COL = 1;
+struct hdr_histogram* histogram;
 
-public:
-    Reader()
-        : reader_(FILE_PATH), cur_(reader_.begin()) {
+void buildIndex(const LaunchOptions& options) {
+    MappedFile file(options.filePath);
+    auto index = SparseIndex::load(file, options.indexStep);
+    index.save();
+    INFO() << "Index " << SparseIndex::pathFor(options.filePath) << ": "
+           << index.entries().size() << " entries, " << index.indexedRows() << " rows";
+}
+
+void launch(const LaunchOptions& options) {
+    if (options.buildIndex) {
+        buildIndex(options);
+        return;
     }
 
-    std::optional<std::string> readLine() {
-        if ((*cur_)[ID_COL] == BTCUSDT::iD1 || (*cur_)[ID_COL] == BTCUSDT::iD2) {
-            return (*cur_++)[DATA_COL].get();
-        }
-        ++cur_;
-        return std::nullopt;
+    prepare(options);
+
+    RunOutputs outputs;
+    if (!options.tracePath.empty()) {
+        Tracer::enable(options.traceSample, options.traceCapacity);
+        Tracer::registerThread("main");
+        outputs.tracePath = options.tracePath;
+    }
+    if (!options.intervalLogDir.empty()) {
+        benchmark::enableIntervalLog(
+            options.intervalLogDir, options.intervalMs, options.intervalMessages);
+        outputs.intervalLogs = true;
     }
 
-    bool valid() const {
-        return cur_ != reader_.end();
+    if (options.liveSource) {
+        launchLive(options);
+        return;
     }
 
-private:
-    Vinces reader_;
-    Vinces::iterator cur_;
-};
+    if (!options.mergePaths.empty()) {
+        launchMerge(options);
+        return;
+    }
 
-}   // namespace
+    if (options.book) {
+        launchBook(options);
+        return;
+    }
 
-struct hdr_histogram* histogram;
+    // Replay from the given point: only seekable readers take part
+    std::optional<SparseIndex> index;
+    const bool replay = options.fromTime || options.fromSeq;
+    REQUIRE(!(replay && options.streamOnly), "Streaming reader can't replay from the index");
+    if (replay) {
+        MappedFile file(options.filePath);
+        index.emplace(SparseIndex::load(file, options.indexStep));
+        index->save();
+        WARN() << "Fastcsv and Vinces readers can't seek, skipped";
+    }
+    auto seekIndexed = [&](auto& reader) {
+        if (options.fromTime) {
+            reader.seekTime(*index, *options.fromTime);
+        } else if (options.fromSeq) {
+            reader.seekSeq(*index, *options.fromSeq);
+        }
+    };
+
+    NlohmannJsonParser nlohmannJsonParser;
+    SimdJsonParser simdJsonParser;
+    CustomParser customParser;
+    CustomAvxParser customAvxParser;
+    FingerprintParser fingerprintParser;
+    BookStats stats;
+    auto shmRing = makeShmRing(options);
+
+    CachePressure pressure(options.cacheMode, options.thrashBytes, options.interleaveSteps);
+    if (pressure.mode() != CacheMode::Hot) {
+        INFO() << "Cache mode " << CacheModeStr(pressure.mode()) << ", buffer "
+               << pressure.bufferSize() << " bytes";
+    }
 
-void launch() {
-    prepare();
+    // Readers below keep the whole file in memory
+    const bool inMemory = !options.streamOnly;
+    // Traced messages are numbered through all the readers. Each record has the read and the
+    // CustomAvx parse (and the publish), the other benchmarks in between are not attributed.
+    uint64_t message = 0;
 
-    {
-        Reader<Fastcsv> reader;
+    if (inMemory && !replay) {
+        Reader<Fastcsv> reader(options.filePath);
         for (; reader.valid();) {
+            const uint64_t readBegin = Tracer::now();
             BENCH_START(ReaderType, Fastcsv);
             auto data = reader.readLine();
             BENCH_END(ReaderType, Fastcsv);
             if (data) {
+                TraceRecord* trace = Tracer::begin(message++, readBegin);
+                Tracer::mark(trace, TraceStage::Read);
+
+                pressure.prepare(*data, nlohmannJsonParser);
                 BENCH_START(ParserType, NlohmannJson);
-                auto btc2 = NlohmannJsonParser::parse(*data);
+                const auto& btc2 = nlohmannJsonParser.parse(*data);
                 BENCH_END(ParserType, NlohmannJson);
+                UNUSED(btc2);
                 //INFO() << btc2;
 
+                pressure.prepare(*data, simdJsonParser);
                 BENCH_START(ParserType, SimdJson);
-                auto btc3 = SimdJsonParser::parse(*data);
+                const auto& btc3 = simdJsonParser.parse(*data);
                 BENCH_END(ParserType, SimdJson);
+                UNUSED(btc3);
                 //INFO() << btc3;
 
+                pressure.prepare(*data, customParser);
                 BENCH_START(ParserType, Custom);
-                auto btc4 = CustomParser::parse(*data);
+                const auto& btc4 = customParser.parse(*data);
                 BENCH_END(ParserType, Custom);
+                UNUSED(btc4);
                 //INFO() << btc4;
 
+                pressure.prepare(*data, customAvxParser);
+                Tracer::start(trace, TraceStage::Parse);
                 BENCH_START(ParserType, CustomAvx);
-                auto btc5 = CustomAvxParser::parse(*data);
+                const auto& btc5 = customAvxParser.parse(*data);
                 BENCH_END(ParserType, CustomAvx);
+                Tracer::mark(trace, TraceStage::Parse);
+                UNUSED(btc5);
                 //INFO() << btc5;
             }
         }
     }
 
-    {
-        Reader<Vinces> reader;
+    if (inMemory && !replay) {
+        Reader<Vinces> reader(options.filePath);
         for (; reader.valid();) {
+            const uint64_t readBegin = Tracer::now();
             BENCH_START(ReaderType, Vinces);
             auto data = reader.readLine();
             BENCH_END(ReaderType, Vinces);
             if (data) {
+                TraceRecord* trace = Tracer::begin(message++, readBegin);
+                Tracer::mark(trace, TraceStage::Read);
+
+                pressure.prepare(*data, nlohmannJsonParser);
                 BENCH_START(ParserType, NlohmannJson);
-                auto btc2 = NlohmannJsonParser::parse(*data);
+                const auto& btc2 = nlohmannJsonParser.parse(*data);
                 BENCH_END(ParserType, NlohmannJson);
+                UNUSED(btc2);
                 //INFO() << btc2;
 
+                pressure.prepare(*data, simdJsonParser);
                 BENCH_START(ParserType, SimdJson);
-                auto btc3 = SimdJsonParser::parse(*data);
+                const auto& btc3 = simdJsonParser.parse(*data);
                 BENCH_END(ParserType, SimdJson);
+                UNUSED(btc3);
                 //INFO() << btc3;
 
+                pressure.prepare(*data, customParser);
                 BENCH_START(ParserType, Custom);
-                auto btc4 = CustomParser::parse(*data);
+                const auto& btc4 = customParser.parse(*data);
                 BENCH_END(ParserType, Custom);
+                UNUSED(btc4);
                 //INFO() << btc4;
 
+                pressure.prepare(*data, customAvxParser);
+                Tracer::start(trace, TraceStage::Parse);
                 BENCH_START(ParserType, CustomAvx);
-                auto btc5 = CustomAvxParser::parse(*data);
+                const auto& btc5 = customAvxParser.parse(*data);
                 BENCH_END(ParserType, CustomAvx);
+                Tracer::mark(trace, TraceStage::Parse);
+                UNUSED(btc5);
                 //INFO() << btc5;
             }
         }
     }
 
-    {
-        Reader<Rapidcsv> reader;
+    if (inMemory) {
+        Reader<Rapidcsv> reader(options.filePath);
+        if (replay) {
+            seekIndexed(reader);
+        }
         for (; reader.valid();) {
+            const uint64_t readBegin = Tracer::now();
             BENCH_START(ReaderType, Rapidcsv);
             auto data = reader.readLine();
             BENCH_END(ReaderType, Rapidcsv);
             if (data) {
+                TraceRecord* trace = Tracer::begin(message++, readBegin);
+                Tracer::mark(trace, TraceStage::Read);
+
+                pressure.prepare(*data, nlohmannJsonParser);
                 BENCH_START(ParserType, NlohmannJson);
-                auto btc2 = NlohmannJsonParser::parse(*data);
+                const auto& btc2 = nlohmannJsonParser.parse(*data);
                 BENCH_END(ParserType, NlohmannJson);
+                UNUSED(btc2);
                 //INFO() << btc2;
 
+                pressure.prepare(*data, simdJsonParser);
                 BENCH_START(ParserType, SimdJson);
-                auto btc3 = SimdJsonParser::parse(*data);
+                const auto& btc3 = simdJsonParser.parse(*data);
                 BENCH_END(ParserType, SimdJson);
+                UNUSED(btc3);
                 //INFO() << btc3;
 
+                pressure.prepare(*data, customParser);
                 BENCH_START(ParserType, Custom);
-                auto btc4 = CustomParser::parse(*data);
+                const auto& btc4 = customParser.parse(*data);
                 BENCH_END(ParserType, Custom);
+                UNUSED(btc4);
                 //INFO() << btc4;
 
+                pressure.prepare(*data, customAvxParser);
+                Tracer::start(trace, TraceStage::Parse);
                 BENCH_START(ParserType, CustomAvx);
-                auto btc5 = CustomAvxParser::parse(*data);
+                const auto& btc5 = customAvxParser.parse(*data);
                 BENCH_END(ParserType, CustomAvx);
+                Tracer::mark(trace, TraceStage::Parse);
+                UNUSED(btc5);
+                //INFO() << btc5;
+            }
+        }
+    }
+
+    if (inMemory) {
+        Reader<Mmap> reader(options.filePath, !replay);
+        if (replay) {
+            seekIndexed(reader);
+        }
+        BTCUSDTBatch batch(BATCH_SIZE, BATCH_ARENA_BYTES, mainPlacement(options).effectiveNode());
+        for (; reader.valid();) {
+            const uint64_t readBegin = Tracer::now();
+            BENCH_START(ReaderType, Mmap);
+            auto data = reader.readLine();
+            BENCH_END(ReaderType, Mmap);
+            if (data) {
+                TraceRecord* trace = Tracer::begin(message++, readBegin);
+                Tracer::mark(trace, TraceStage::Read);
+
+                pressure.prepare(*data, customParser);
+                BENCH_START(ParserType, CustomEscaped);
+                const auto& btc4 = customParser.parseEscaped(*data);
+                BENCH_END(ParserType, CustomEscaped);
+                UNUSED(btc4);
+                //INFO() << btc4;
+
+                pressure.prepare(*data, customAvxParser);
+                Tracer::start(trace, TraceStage::Parse);
+                BENCH_START(ParserType, CustomAvxEscaped);
+                const auto& btc5 = customAvxParser.parseEscaped(*data);
+                BENCH_END(ParserType, CustomAvxEscaped);
+                Tracer::mark(trace, TraceStage::Parse);
+                //INFO() << btc5;
+
+                BENCH_START(AnalyticsType, Scalar);
+                computeStats(btc5, TOP_LEVELS, stats);
+                BENCH_END(AnalyticsType, Scalar);
+
+                BENCH_START(AnalyticsType, Avx);
+                computeStatsAvx(btc5, TOP_LEVELS, stats);
+                BENCH_END(AnalyticsType, Avx);
+
+                if (shmRing) {
+                    Tracer::start(trace, TraceStage::Publish);
+                    BENCH_START(SinkType, ShmRing);
+                    shmRing->publish(btc5.t, btc5.u, btc5.asks, btc5.bids);
+                    BENCH_END(SinkType, ShmRing);
+                    Tracer::mark(trace, TraceStage::Publish);
+                }
+
+                pressure.prepare(*data);
+                BENCH_START(ParserType, LazyTopEscaped);
+                auto view = BTCUSDTView::fromEscaped(*data);
+                auto topAsks = view.asks().top(TOP_LEVELS);
+                auto topBids = view.bids().top(TOP_LEVELS);
+                BENCH_END(ParserType, LazyTopEscaped);
+                UNUSED(topAsks);
+                UNUSED(topBids);
+
+                if (batch.full()) {
+                    batch.reset();
+                }
+                pressure.prepare(*data, batch);
+                BENCH_START(ParserType, CustomAvxBatch);
+                customAvxParser.parseEscaped(*data, batch.emplace());
+                BENCH_END(ParserType, CustomAvxBatch);
+
+                pressure.prepare(*data, fingerprintParser);
+                BENCH_START(ParserType, FingerprintEscaped);
+                const auto& btc6 = fingerprintParser.parseEscaped(*data, reader.id());
+                BENCH_END(ParserType, FingerprintEscaped);
+                UNUSED(btc6);
+                //INFO() << btc6;
+            }
+        }
+        INFO() << "Fingerprint layouts learned: " << fingerprintParser.learned();
+    }
+
+    if (!replay) {
+        Reader<Stream> reader(
+            options.filePath,
+            options.streamBlockSize,
+            BlockReader::defaultBlocks,
+            mainPlacement(options).effectiveNode());
+        for (; reader.valid();) {
+            const uint64_t readBegin = Tracer::now();
+            BENCH_START(ReaderType, Stream);
+            auto data = reader.readLine();
+            BENCH_END(ReaderType, Stream);
+            if (data) {
+                TraceRecord* trace = Tracer::begin(message++, readBegin);
+                Tracer::mark(trace, TraceStage::Read);
+
+                pressure.prepare(*data, customParser);
+                BENCH_START(ParserType, CustomEscaped);
+                const auto& btc4 = customParser.parseEscaped(*data);
+                BENCH_END(ParserType, CustomEscaped);
+                UNUSED(btc4);
+                //INFO() << btc4;
+
+                pressure.prepare(*data, customAvxParser);
+                Tracer::start(trace, TraceStage::Parse);
+                BENCH_START(ParserType, CustomAvxEscaped);
+                const auto& btc5 = customAvxParser.parseEscaped(*data);
+                BENCH_END(ParserType, CustomAvxEscaped);
+                Tracer::mark(trace, TraceStage::Parse);
+                UNUSED(btc5);
                 //INFO() << btc5;
             }
         }
+        INFO() << "Stream reader io: " << (reader.blocks().usesUring() ? "io_uring" : "pread");
     }
 
-    INFO() << BENCH_DISTR(ReaderType, Fastcsv);
-    INFO() << BENCH_DISTR(ReaderType, Vinces);
-    INFO() << BENCH_DISTR(ReaderType, Rapidcsv);
-    INFO() << BENCH_DISTR(ParserType, NlohmannJson);
-    INFO() << BENCH_DISTR(ParserType, SimdJson);
-    INFO() << BENCH_DISTR(ParserType, Custom);
-    INFO() << BENCH_DISTR(ParserType, CustomAvx);
+    PRINT_DISTR(ReaderType, Fastcsv);
+    PRINT_DISTR(ReaderType, Vinces);
+    PRINT_DISTR(ReaderType, Rapidcsv);
+    PRINT_DISTR(ReaderType, Mmap);
+    PRINT_DISTR(ReaderType, Stream);
+    PRINT_DISTR(ParserType, NlohmannJson);
+    PRINT_DISTR(ParserType, SimdJson);
+    PRINT_DISTR(ParserType, Custom);
+    PRINT_DISTR(ParserType, CustomAvx);
+    PRINT_DISTR(ParserType, CustomEscaped);
+    PRINT_DISTR(ParserType, CustomAvxEscaped);
+    PRINT_DISTR(ParserType, LazyTopEscaped);
+    PRINT_DISTR(ParserType, CustomAvxBatch);
+    PRINT_DISTR(ParserType, FingerprintEscaped);
+    PRINT_DISTR(AnalyticsType, Scalar);
+    PRINT_DISTR(AnalyticsType, Avx);
+    PRINT_DISTR(SinkType, ShmRing);
 }
 
 }   // namespace ozma
@@ -1,7 +1,71 @@
 #pragma once
 
+#include "cache_pressure.h"
+#include "tail_reader.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <string>
+#include <vector>
+
 namespace ozma {
 
-void launch();
+struct LaunchOptions {
+    std::string filePath = "./csv/data.csv";
+    // Sparse index <file>.idx: rows per entry
+    size_t indexStep = 4096;
+    // Only build or update the index
+    bool buildIndex = false;
+    // Replay from the first message with T >= fromTime or u >= fromSeq
+    std::optional<int64_t> fromTime;
+    std::optional<int64_t> fromSeq;
+    // Only the streaming reader: memory footprint doesn't depend on the file size
+    bool streamOnly = false;
+    size_t streamBlockSize = 4 << 20;
+    // Cpu lists ("0-3,8"): benchmark thread (reader and parsers) and logger thread
+    std::string mainCpus;
+    std::string loggerCpus;
+    // Numa node for buffers of the benchmark thread, negative: node of its first cpu
+    int numaNode = -1;
+    // Live mode: rows from a growing file, stdin or a unix socket instead of the benchmark
+    std::optional<TailReader::Source> liveSource;
+    std::string livePath;
+    bool liveFromStart = false;
+    // Merge mode: these files as one stream ordered by (T, u), a parsing thread per file
+    std::vector<std::string> mergePaths;
+    // Cpu list for the parsing threads, one cpu per file
+    std::string mergeCpus;
+    // Shared memory ring the parsed updates are published to (empty: none)
+    std::string shmRing;
+    size_t shmCapacity = 1 << 16;
+    // Numa node of the ring consumers, negative: not bound
+    int shmNode = -1;
+    // Book mode: replays the file into an order book instead of the benchmark
+    bool book = false;
+    // Book mode: checkpoint every N messages, 0: none
+    size_t checkpointEvery = 0;
+    // Book mode: start from the latest checkpoint (at or before --from-time/--from-u if given)
+    bool restore = false;
+    // Chrome trace of sampled messages (read, parse, book, publish stages), empty: off
+    std::string tracePath;
+    // Every N-th message of each thread is traced
+    size_t traceSample = 100;
+    // Trace records preallocated per thread
+    size_t traceCapacity = 1 << 18;
+    // HdrHistogram interval logs, one <dir>/<BenchType>.<BenchName>.hlog per benchmark, empty: off
+    std::string intervalLogDir;
+    // An interval ends after this many ms or messages, 0: unused
+    int64_t intervalMs = 1000;
+    uint64_t intervalMessages = 0;
+    // Cache state before each parser call, Hot: back to back on the same message
+    CacheMode cacheMode = CacheMode::Hot;
+    // Thrash and Interleave buffer, 0: twice the LLC
+    size_t thrashBytes = 0;
+    // Interleave: random accesses between calls
+    size_t interleaveSteps = 4096;
+};
+
+void launch(const LaunchOptions& options);
 
 }   // namespace ozma
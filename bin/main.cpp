@@ -12,7 +12,88 @@ int main(int argc, char* argv[]) try {
     opt::options_description desc("all options");
     opt::variables_map vm;
 
-    desc.add_options()("help,h", "Show help");
+    ozma::LaunchOptions options;
+    desc.add_options()("help,h", "Show help")(
+        "file,f", opt::value(&options.filePath)->default_value(options.filePath), "Csv file")(
+        "index-step",
+        opt::value(&options.indexStep)->default_value(options.indexStep),
+        "Rows per sparse index entry")(
+        "build-index",
+        opt::bool_switch(&options.buildIndex),
+        "Build or update <file>.idx and exit")(
+        "from-time", opt::value<int64_t>(), "Replay from the first message with T >= value")(
+        "from-u", opt::value<int64_t>(), "Replay from the first message with u >= value")(
+        "stream",
+        opt::bool_switch(&options.streamOnly),
+        "Only the streaming reader, for files larger than RAM")(
+        "stream-block",
+        opt::value(&options.streamBlockSize)->default_value(options.streamBlockSize),
+        "Streaming reader block size in bytes")(
+        "cpus",
+        opt::value(&options.mainCpus),
+        "Cpu list for the benchmark thread, e.g. 2-3 (default: last cpu)")(
+        "logger-cpus", opt::value(&options.loggerCpus), "Cpu list for the logger thread")(
+        "numa-node",
+        opt::value(&options.numaNode)->default_value(options.numaNode),
+        "Numa node for benchmark buffers (default: node of the first benchmark cpu)")(
+        "tail", opt::value<std::string>(), "Live mode: follow a growing csv file")(
+        "tail-stdin", "Live mode: rows from stdin")(
+        "tail-socket", opt::value<std::string>(), "Live mode: rows from a unix socket")(
+        "tail-from-start",
+        opt::bool_switch(&options.liveFromStart),
+        "Followed file is read from the beginning, not from its current end")(
+        "merge",
+        opt::value(&options.mergePaths)->multitoken(),
+        "Merge mode: several csv files as one stream ordered by T, parsed in parallel")(
+        "merge-cpus",
+        opt::value(&options.mergeCpus),
+        "Cpu list for the merge parsing threads, one cpu per file")(
+        "shm-ring",
+        opt::value(&options.shmRing),
+        "Publish parsed updates to a shared memory ring, e.g. /btcusdt")(
+        "shm-capacity",
+        opt::value(&options.shmCapacity)->default_value(options.shmCapacity),
+        "Shared memory ring slots")(
+        "shm-node",
+        opt::value(&options.shmNode)->default_value(options.shmNode),
+        "Numa node of the shared memory ring, where its consumers run (default: not bound)")(
+        "book",
+        opt::bool_switch(&options.book),
+        "Book mode: replay the file into an order book")(
+        "checkpoint-every",
+        opt::value(&options.checkpointEvery)->default_value(options.checkpointEvery),
+        "Book mode: write a checkpoint to <file>.ckpt/ every N updates, 0: never")(
+        "restore",
+        opt::bool_switch(&options.restore),
+        "Book mode: resume from the latest checkpoint, at or before --from-time/--from-u")(
+        "trace",
+        opt::value(&options.tracePath),
+        "Write a Chrome trace (chrome://tracing, ui.perfetto.dev) of sampled messages")(
+        "trace-sample",
+        opt::value(&options.traceSample)->default_value(options.traceSample),
+        "Trace every N-th message of each thread")(
+        "trace-capacity",
+        opt::value(&options.traceCapacity)->default_value(options.traceCapacity),
+        "Trace records preallocated per thread")(
+        "interval-log",
+        opt::value(&options.intervalLogDir),
+        "Write every benchmark as HdrHistogram interval logs into this directory")(
+        "interval-ms",
+        opt::value(&options.intervalMs)->default_value(options.intervalMs),
+        "Interval length in ms, 0: by messages only")(
+        "interval-messages",
+        opt::value(&options.intervalMessages)->default_value(options.intervalMessages),
+        "Interval length in recorded values, 0: by time only")(
+        "cache-mode",
+        opt::value<std::string>()->default_value("hot"),
+        "Cache before each parser call: hot, flush (clflush message and parser), thrash (walk "
+        "a buffer larger than the LLC) or interleave (random accesses between calls)")(
+        "thrash-bytes",
+        opt::value(&options.thrashBytes)->default_value(options.thrashBytes),
+        "Thrash/interleave buffer size, 0: twice the LLC")(
+        "interleave-steps",
+        opt::value(&options.interleaveSteps)->default_value(options.interleaveSteps),
+        "Random accesses between calls in interleave mode");
 
     opt::store(opt::parse_command_line(argc, argv, desc), vm);
     opt::notify(vm);
@@ -22,7 +103,26 @@ int main(int argc, char* argv[]) try {
         return EXIT_SUCCESS;
     }
 
-    ozma::launch();
+    if (vm.contains("from-time")) {
+        options.fromTime = vm["from-time"].as<int64_t>();
+    }
+    if (vm.contains("from-u")) {
+        options.fromSeq = vm["from-u"].as<int64_t>();
+    }
+
+    options.cacheMode = ozma::parseCacheMode(vm["cache-mode"].as<std::string>());
+
+    if (vm.contains("tail")) {
+        options.liveSource = ozma::TailReader::Source::File;
+        options.livePath = vm["tail"].as<std::string>();
+    } else if (vm.contains("tail-stdin")) {
+        options.liveSource = ozma::TailReader::Source::Stdin;
+    } else if (vm.contains("tail-socket")) {
+        options.liveSource = ozma::TailReader::Source::Socket;
+        options.livePath = vm["tail-socket"].as<std::string>();
+    }
+
+    ozma::launch(options);
 
     return EXIT_SUCCESS;
 } catch (std::exception& ex) {
@@ -0,0 +1,135 @@
+#include "csv_row.h"
+#include "mapped_file.h"
+
+#include "utils/common.h"
+#include "utils/logger.h"
+
+#include <boost/program_options.hpp>
+
+#include <algorithm>
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <fcntl.h>
+#include <string_view>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+// Stands in for the live feed: writes csv rows at a given rate into a file (appending),
+// stdout or a unix socket, for csv_parser_bin --tail / --tail-stdin / --tail-socket
+
+namespace opt = boost::program_options;
+
+namespace {
+
+int listenUnix(const std::string& path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    REQUIRE(fd != -1, "Can't create socket: " << std::strerror(errno));
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    REQUIRE(path.size() < sizeof(addr.sun_path), "Socket path is too long: " << path);
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    unlink(path.c_str());
+    REQUIRE(
+        bind(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0,
+        "Can't bind " << path << ": " << std::strerror(errno));
+    REQUIRE(listen(fd, 1) == 0, "Can't listen " << path << ": " << std::strerror(errno));
+    INFO() << "Waiting for a reader on " << path;
+    int client = accept(fd, nullptr, nullptr);
+    REQUIRE(client != -1, "Accept error: " << std::strerror(errno));
+    close(fd);
+    return client;
+}
+
+void writeFully(int fd, const char* data, size_t len) {
+    while (len > 0) {
+        const ssize_t res = write(fd, data, len);
+        if (res < 0 && errno == EINTR) {
+            continue;
+        }
+        REQUIRE(res > 0, "Write error: " << std::strerror(errno));
+        data += res;
+        len -= static_cast<size_t>(res);
+    }
+}
+
+}   // namespace
+
+int main(int argc, char* argv[]) try {
+    // Rows go to stdout with --out -, the log goes to the file then
+    const bool rowsToStdout = std::any_of(argv + 1, argv + argc, [](std::string_view arg) {
+        return arg == "-" || arg == "--out=-" || arg == "-o-";
+    });
+    if (rowsToStdout) {
+        INIT_LOGGER({ ozma::Logger::Out::File });
+    } else {
+        INIT_LOGGER({ ozma::Logger::Out::Stdout });
+    }
+
+    opt::options_description desc("all options");
+    opt::variables_map vm;
+
+    std::string filePath = "./csv/data.csv";
+    std::string outPath;
+    std::string socketPath;
+    double rate = 1000.;
+    size_t rows = 0;
+    desc.add_options()("help,h", "Show help")(
+        "file,f", opt::value(&filePath)->default_value(filePath), "Source csv file")(
+        "out,o", opt::value(&outPath), "Append rows to this file, - for stdout")(
+        "socket", opt::value(&socketPath), "Serve rows on this unix socket")(
+        "rate", opt::value(&rate)->default_value(rate), "Rows per second, 0: as fast as possible")(
+        "rows", opt::value(&rows)->default_value(rows), "Rows to write, 0: the whole file");
+
+    opt::store(opt::parse_command_line(argc, argv, desc), vm);
+    opt::notify(vm);
+
+    if (vm.contains("help")) {
+        INFO() << desc;
+        return EXIT_SUCCESS;
+    }
+    REQUIRE(outPath.empty() != socketPath.empty(), "Exactly one of --out and --socket is needed");
+
+    int fd = -1;
+    if (!socketPath.empty()) {
+        fd = listenUnix(socketPath);
+    } else if (outPath == "-") {
+        fd = STDOUT_FILENO;
+    } else {
+        fd = open(outPath.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+        REQUIRE(fd != -1, "Can't open " << outPath);
+    }
+
+    ozma::MappedFile file(filePath);
+    const auto start = std::chrono::steady_clock::now();
+    const char* pos = file.data();
+    size_t written = 0;
+    while (pos < file.end() && (rows == 0 || written < rows)) {
+        const char* next = ozma::nextRow(pos, file.end());
+        if (*pos != '\"') {
+            // header
+            pos = next;
+            continue;
+        }
+        if (rate > 0) {
+            std::this_thread::sleep_until(
+                start + std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+                            std::chrono::duration<double>(written / rate)));
+        }
+        writeFully(fd, pos, next - pos);
+        written++;
+        pos = next;
+    }
+
+    if (fd != STDOUT_FILENO) {
+        close(fd);
+    }
+    INFO() << "Written " << written << " rows";
+    ozma::Logger::waitLogThread();
+    return EXIT_SUCCESS;
+} catch (std::exception& ex) {
+    ERROR() << ex.what();
+    return EXIT_FAILURE;
+}
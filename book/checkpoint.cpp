@@ -0,0 +1,211 @@
+#include "checkpoint.h"
+
+#include "common.h"
+#include "csv_row.h"
+#include "layout.h"
+#include "logger.h"
+
+#include <algorithm>
+#include <charconv>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <vector>
+
+namespace ozma {
+
+namespace {
+
+const char CHECKPOINT_MAGIC[8] = { 'B', 'O', 'O', 'K', 'C', 'K', 'P', '1' };
+
+// <u>-<T>.book, zero-padded: sorted by name is sorted by u
+std::string fileName(int64_t u, int64_t t) {
+    char name[64];
+    std::snprintf(
+        name,
+        sizeof(name),
+        "%020lld-%020lld.book",
+        static_cast<long long>(u),
+        static_cast<long long>(t));
+    return name;
+}
+
+bool parseFileName(const std::string& name, int64_t& u, int64_t& t) {
+    const char* end = name.data() + name.size();
+    auto [uEnd, uEc] = std::from_chars(name.data(), end, u);
+    if (uEc != std::errc() || uEnd == end || *uEnd != '-') {
+        return false;
+    }
+    auto [tEnd, tEc] = std::from_chars(uEnd + 1, end, t);
+    return tEc == std::errc() && std::string_view(tEnd, end - tEnd) == ".book";
+}
+
+// u of the last BTCUSDT row ending at or before offset, nullopt if there is none
+std::optional<int64_t> lastSeqBefore(const MappedFile& csv, uint64_t offset) {
+    const char* data = csv.data();
+    const char* rowEnd = data + offset;
+    while (rowEnd > data) {
+        // rowEnd - 1 is the '\n' of the row itself
+        const void* nl = memrchr(data, '\n', static_cast<size_t>(rowEnd - 1 - data));
+        const char* rowBeg = nl ? static_cast<const char*>(nl) + 1 : data;
+        CsvRow row;
+        splitRow(rowBeg, rowEnd, row);
+        if (*rowBeg == '\"' && (row.id == BTCUSDT::iD1 || row.id == BTCUSDT::iD2)) {
+            if (row.body.size() < Layout<2>::uBeg + Layout<2>::len) {
+                return std::nullopt;
+            }
+            return parseStamp<2>(row.body).u;
+        }
+        rowEnd = rowBeg;
+    }
+    return std::nullopt;
+}
+
+}   // namespace
+
+void CheckpointStore::write(const Checkpoint& checkpoint) const {
+    std::filesystem::create_directories(dir_);
+    const OrderBook& book = checkpoint.book;
+
+    Header header{};
+    std::memcpy(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC));
+    header.t = book.t();
+    header.u = book.u();
+    header.offset = checkpoint.offset;
+    header.row = checkpoint.row;
+    header.asks = book.asks().size();
+    header.bids = book.bids().size();
+
+    const std::string path = dir_ + "/" + fileName(book.u(), book.t());
+    const std::string tmpPath = path + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        REQUIRE(out.is_open(), "Can't write " << tmpPath);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(
+            reinterpret_cast<const char*>(book.asks().data()),
+            static_cast<std::streamsize>(book.asks().size() * sizeof(Order)));
+        out.write(
+            reinterpret_cast<const char*>(book.bids().data()),
+            static_cast<std::streamsize>(book.bids().size() * sizeof(Order)));
+        REQUIRE(out.good(), "Can't write " << tmpPath);
+    }
+    REQUIRE(std::rename(tmpPath.c_str(), path.c_str()) == 0, "Can't replace " << path);
+}
+
+std::optional<Checkpoint> CheckpointStore::read(
+    const std::string& path, const MappedFile& csv) const {
+    std::error_code ec;
+    const uint64_t fileSize = std::filesystem::file_size(path, ec);
+    std::ifstream in(path, std::ios::binary);
+    Header header{};
+    if (ec || !in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, CHECKPOINT_MAGIC, sizeof(CHECKPOINT_MAGIC)) != 0) {
+        return std::nullopt;
+    }
+    // Damaged counts must not turn into a huge allocation
+    const uint64_t maxLevels = (fileSize - sizeof(header)) / sizeof(Order);
+    if (header.asks > maxLevels || header.bids > maxLevels - header.asks ||
+        fileSize != sizeof(header) + (header.asks + header.bids) * sizeof(Order)) {
+        return std::nullopt;
+    }
+    // The csv may only have grown since: the offset is still a row boundary inside it,
+    // right after the last update applied to the book
+    if (header.offset > csv.size() ||
+        (header.offset > 0 && csv.data()[header.offset - 1] != '\n') ||
+        lastSeqBefore(csv, header.offset).value_or(0) != header.u) {
+        return std::nullopt;
+    }
+    std::vector<Order> levels(header.asks + header.bids);
+    if (!in.read(
+            reinterpret_cast<char*>(levels.data()),
+            static_cast<std::streamsize>(levels.size() * sizeof(Order)))) {
+        return std::nullopt;
+    }
+    Checkpoint checkpoint;
+    checkpoint.book.assign(
+        header.t,
+        header.u,
+        levels.data(),
+        header.asks,
+        levels.data() + header.asks,
+        header.bids);
+    checkpoint.offset = header.offset;
+    checkpoint.row = header.row;
+    return checkpoint;
+}
+
+std::optional<Checkpoint> CheckpointStore::loadNearest(
+    const MappedFile& csv, std::optional<int64_t> maxT, std::optional<int64_t> maxU) const {
+    std::vector<std::string> names;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(dir_, ec)) {
+        int64_t u = 0;
+        int64_t t = 0;
+        const std::string name = entry.path().filename().string();
+        if (parseFileName(name, u, t) && (!maxT || t <= *maxT) && (!maxU || u <= *maxU)) {
+            names.push_back(name);
+        }
+    }
+    // Latest first, falls back to earlier ones if a file is damaged or doesn't fit the csv
+    std::sort(names.rbegin(), names.rend());
+    for (const auto& name : names) {
+        if (auto checkpoint = read(dir_ + "/" + name, csv)) {
+            return checkpoint;
+        }
+        WARN() << "Checkpoint " << name << " doesn't fit " << csv.path() << ", skipped";
+    }
+    return std::nullopt;
+}
+
+CheckpointWriter::CheckpointWriter(const std::string& csvPath)
+    : store_(csvPath)
+    , thread_(&CheckpointWriter::run, this) {
+}
+
+CheckpointWriter::~CheckpointWriter() {
+    {
+        std::lock_guard lock(mutex_);
+        stop_ = true;
+    }
+    cv_.notify_one();
+    thread_.join();
+}
+
+bool CheckpointWriter::submit(const OrderBook& book, uint64_t offset, uint64_t row) {
+    std::unique_lock lock(mutex_, std::try_to_lock);
+    if (!lock.owns_lock() || hasPending_) {
+        skipped_++;
+        return false;
+    }
+    pending_.book = book;
+    pending_.offset = offset;
+    pending_.row = row;
+    hasPending_ = true;
+    lock.unlock();
+    cv_.notify_one();
+    return true;
+}
+
+void CheckpointWriter::run() {
+    std::unique_lock lock(mutex_);
+    for (;;) {
+        cv_.wait(lock, [this] { return hasPending_ || stop_; });
+        if (hasPending_) {
+            // The lock stays held: submit() skips instead of waiting for the disk
+            try {
+                store_.write(pending_);
+                written_++;
+            } catch (std::exception& ex) {
+                ERROR() << "Checkpoint: " << ex.what();
+            }
+            hasPending_ = false;
+        }
+        if (stop_) {
+            return;
+        }
+    }
+}
+
+}   // namespace ozma
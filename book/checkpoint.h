@@ -0,0 +1,99 @@
+#pragma once
+
+#include "order_book.h"
+
+#include "mapped_file.h"
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+namespace ozma {
+
+struct Checkpoint {
+    OrderBook book;
+    // Where the replay resumes: the row after the last applied update
+    uint64_t offset{};
+    uint64_t row{};
+};
+
+// Checkpoints of a csv in <csv>.ckpt/, a file per checkpoint named after its u and T
+class CheckpointStore {
+public:
+    explicit CheckpointStore(const std::string& csvPath)
+        : dir_(dirFor(csvPath)) {
+    }
+
+    static std::string dirFor(const std::string& csvPath) {
+        return csvPath + ".ckpt";
+    }
+
+    // Atomic: a reader never sees a half-written checkpoint
+    void write(const Checkpoint& checkpoint) const;
+
+    // Latest checkpoint with T <= maxT and u <= maxU (when given) that fits the csv,
+    // nullopt if there is none
+    std::optional<Checkpoint> loadNearest(
+        const MappedFile& csv,
+        std::optional<int64_t> maxT = std::nullopt,
+        std::optional<int64_t> maxU = std::nullopt) const;
+
+private:
+    struct Header {
+        char magic[8];
+        int64_t t;
+        int64_t u;
+        uint64_t offset;
+        uint64_t row;
+        uint64_t asks;
+        uint64_t bids;
+    };
+
+    std::optional<Checkpoint> read(const std::string& path, const MappedFile& csv) const;
+
+    std::string dir_;
+};
+
+// Writes checkpoints on its own thread. submit() copies the book and returns: the disk is never
+// on the caller's path, a checkpoint submitted while the previous one is still being written
+// is skipped.
+class CheckpointWriter {
+public:
+    explicit CheckpointWriter(const std::string& csvPath);
+    // Writes the pending checkpoint, if any
+    ~CheckpointWriter();
+
+    CheckpointWriter(const CheckpointWriter&) = delete;
+    CheckpointWriter& operator=(const CheckpointWriter&) = delete;
+
+    // False if skipped
+    bool submit(const OrderBook& book, uint64_t offset, uint64_t row);
+
+    size_t written() const {
+        return written_;
+    }
+
+    size_t skipped() const {
+        return skipped_;
+    }
+
+private:
+    void run();
+
+    CheckpointStore store_;
+    // Levels keep their capacity between checkpoints
+    Checkpoint pending_;
+    bool hasPending_ = false;
+    bool stop_ = false;
+    std::mutex mutex_;
+    std::condition_variable cv_;
+    std::atomic<size_t> written_{ 0 };
+    std::atomic<size_t> skipped_{ 0 };
+    std::thread thread_;
+};
+
+}   // namespace ozma
@@ -0,0 +1,54 @@
+#include "order_book.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace ozma {
+
+namespace {
+
+template <typename Compare>
+void applySide(Orders& side, const Orders& levels, Compare better) {
+    for (const auto& level : levels) {
+        auto it = std::lower_bound(
+            side.begin(), side.end(), level.price, [&](const Order& order, float price) {
+                return better(order.price, price);
+            });
+        const bool found = it != side.end() && it->price == level.price;
+        if (level.size == 0) {
+            if (found) {
+                side.erase(it);
+            }
+        } else if (found) {
+            it->size = level.size;
+        } else {
+            side.insert(it, level);
+        }
+    }
+}
+
+}   // namespace
+
+void OrderBook::apply(const BTCUSDT& update) {
+    applySide(asks_, update.asks, std::less<float>());
+    applySide(bids_, update.bids, std::greater<float>());
+    t_ = update.t;
+    u_ = update.u;
+}
+
+void OrderBook::clear() {
+    t_ = 0;
+    u_ = 0;
+    asks_.clear();
+    bids_.clear();
+}
+
+void OrderBook::assign(
+    int64_t t, int64_t u, const Order* asks, size_t asksSize, const Order* bids, size_t bidsSize) {
+    t_ = t;
+    u_ = u;
+    asks_.assign(asks, asks + asksSize);
+    bids_.assign(bids, bids + bidsSize);
+}
+
+}   // namespace ozma
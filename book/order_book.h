@@ -0,0 +1,53 @@
+#pragma once
+
+#include "parser.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace ozma {
+
+// Book reconstructed from depth updates: a level's size is replaced, size 0 removes the level.
+// Sides are sorted vectors (best price first), books are a few hundred levels deep and updates
+// land near the top, so this beats node-based maps and a snapshot is a plain copy.
+class OrderBook {
+public:
+    void apply(const BTCUSDT& update);
+    void clear();
+
+    // Of the last applied update
+    int64_t t() const {
+        return t_;
+    }
+
+    int64_t u() const {
+        return u_;
+    }
+
+    // Ascending prices
+    const Orders& asks() const {
+        return asks_;
+    }
+
+    // Descending prices
+    const Orders& bids() const {
+        return bids_;
+    }
+
+    // Restores a snapshot taken with the accessors above
+    void assign(
+        int64_t t,
+        int64_t u,
+        const Order* asks,
+        size_t asksSize,
+        const Order* bids,
+        size_t bidsSize);
+
+private:
+    int64_t t_ = 0;
+    int64_t u_ = 0;
+    Orders asks_;
+    Orders bids_;
+};
+
+}   // namespace ozma
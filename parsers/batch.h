@@ -0,0 +1,75 @@
+#pragma once
+
+#include "arena.h"
+#include "parser.h"
+
+#include <algorithm>
+#include <vector>
+
+namespace ozma {
+
+// Parsed messages of one batch. Levels of every message live in the batch arena,
+// so there are no per-message frees and consecutive messages are adjacent in memory.
+// Messages are invalidated by reset().
+class BTCUSDTBatch {
+public:
+    // node: numa node of the thread reading the batch, negative: not bound
+    BTCUSDTBatch(size_t capacity, size_t arenaBytes, int node = -1)
+        : arena_(arenaBytes, node) {
+        messages_.reserve(capacity);
+    }
+
+    // New message bound to the arena, pass it to Parser::parse(message, result)
+    BTCUSDT& emplace() {
+        lastUsed_ = arena_.used();
+        return messages_.emplace_back(BTCUSDT::allocator_type(arena_.resource()));
+    }
+
+    void reset() {
+        messages_.clear();
+        arena_.reset();
+        lastUsed_ = 0;
+    }
+
+    size_t size() const {
+        return messages_.size();
+    }
+
+    bool full() const {
+        return messages_.size() == messages_.capacity();
+    }
+
+    // What a parse into the batch touches: the last message with its levels in the arena and
+    // the slot emplace() takes next. Not the whole preallocated batch: a flush per call has to
+    // stay cheap next to the call.
+    template <typename Visit>
+    void visitBuffers(Visit&& visit) const {
+        visit(this, sizeof(*this));
+        arena_.visitBuffers(visit, lastUsed_);
+        const size_t first = messages_.empty() ? 0 : messages_.size() - 1;
+        const size_t last = std::min(messages_.size() + 1, messages_.capacity());
+        if (last > first) {
+            visit(messages_.data() + first, (last - first) * sizeof(BTCUSDT));
+        }
+    }
+
+    const BTCUSDT& operator[](size_t i) const {
+        return messages_[i];
+    }
+
+    auto begin() const {
+        return messages_.begin();
+    }
+
+    auto end() const {
+        return messages_.end();
+    }
+
+private:
+    Arena arena_;
+    std::vector<BTCUSDT> messages_;
+    // arena_.used() when the last message was emplaced: where its levels start
+    size_t lastUsed_ = 0;
+};
+
+}   // namespace ozma
@@ -0,0 +1,139 @@
+#pragma once
+
+#include <algorithm>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <string_view>
+
+namespace ozma {
+
+// Fixed offsets of the depthUpdate message, where every '"' takes Q bytes:
+// Q = 1 for plain json, Q = 2 for the csv-escaped body ('"' is written as "").
+template <size_t Q>
+struct Layout {
+    constexpr static size_t tBeg = 33 + 8 * Q;
+    constexpr static size_t uBeg = 75 + 16 * Q;
+    constexpr static size_t len = 13;
+    constexpr static size_t abBeg = 106 + 19 * Q;
+    // a":[["
+    constexpr static size_t abPadding = 4 + 2 * Q;
+    // ","
+    constexpr static size_t priceTail = 1 + 2 * Q;
+    // "],["
+    constexpr static size_t sizeTail = 3 + 2 * Q;
+};
+
+struct Stamp {
+    int64_t t{};
+    int64_t u{};
+};
+
+// T and u of the message, levels are not touched
+template <size_t Q>
+Stamp parseStamp(std::string_view message) {
+    using L = Layout<Q>;
+    Stamp stamp;
+    std::from_chars(message.data() + L::tBeg, message.data() + L::tBeg + L::len, stamp.t);
+    std::from_chars(message.data() + L::uBeg, message.data() + L::uBeg + L::len, stamp.u);
+    return stamp;
+}
+
+// Keys the fingerprint is anchored to, with Q bytes per '"'
+template <size_t Q>
+struct Keys;
+
+template <>
+struct Keys<1> {
+    constexpr static std::string_view t = "\"T\":";
+    constexpr static std::string_view u = "\"u\":";
+    constexpr static std::string_view asks = "\"a\":[[\"";
+    constexpr static std::string_view bids = "\"b\":[[\"";
+};
+
+template <>
+struct Keys<2> {
+    constexpr static std::string_view t = "\"\"T\"\":";
+    constexpr static std::string_view u = "\"\"u\"\":";
+    constexpr static std::string_view asks = "\"\"a\"\":[[\"\"";
+    constexpr static std::string_view bids = "\"\"b\"\":[[\"\"";
+};
+
+// Offsets learned from a message instead of the fixed Layout: survives reordered or added
+// fields and timestamps of another width
+struct Fingerprint {
+    uint32_t tBeg{};
+    uint32_t tLen{};
+    uint32_t uBeg{};
+    uint32_t uLen{};
+    // First side key, 'a' or 'b'
+    uint32_t abBeg{};
+    // Shortest message all the checked bytes fit in
+    uint32_t minSize{};
+};
+
+namespace detail {
+
+inline uint32_t digitsAt(std::string_view message, size_t pos) {
+    size_t len = 0;
+    for (; pos + len < message.size() && message[pos + len] >= '0' && message[pos + len] <= '9';
+         len++) {
+    }
+    return static_cast<uint32_t>(len);
+}
+
+// A number is the last field of its object or is followed by another one
+inline bool numberEnd(char c) {
+    return c == ',' || c == '}';
+}
+
+inline bool keyAt(std::string_view message, size_t pos, std::string_view key) {
+    return pos + key.size() <= message.size() &&
+           std::memcmp(message.data() + pos, key.data(), key.size()) == 0;
+}
+
+}   // namespace detail
+
+// Full scan for the keys, nullopt if the message doesn't have them
+template <size_t Q>
+std::optional<Fingerprint> learnFingerprint(std::string_view message) {
+    using K = Keys<Q>;
+    const size_t tKey = message.find(K::t);
+    const size_t uKey = message.find(K::u);
+    const size_t abKey = std::min(message.find(K::asks), message.find(K::bids));
+    if (tKey == std::string_view::npos || uKey == std::string_view::npos ||
+        abKey == std::string_view::npos) {
+        return std::nullopt;
+    }
+    Fingerprint fp;
+    fp.tBeg = static_cast<uint32_t>(tKey + K::t.size());
+    fp.tLen = detail::digitsAt(message, fp.tBeg);
+    fp.uBeg = static_cast<uint32_t>(uKey + K::u.size());
+    fp.uLen = detail::digitsAt(message, fp.uBeg);
+    fp.abBeg = static_cast<uint32_t>(abKey + Q);
+    if (fp.tLen == 0 || fp.uLen == 0) {
+        return std::nullopt;
+    }
+    fp.minSize = std::max(
+        { fp.tBeg + fp.tLen + 1,
+          fp.uBeg + fp.uLen + 1,
+          static_cast<uint32_t>(fp.abBeg - Q + K::bids.size()) });
+    return fp;
+}
+
+// Cheap revalidation: the keys are where they were and the timestamps kept their width
+template <size_t Q>
+bool matchesFingerprint(const Fingerprint& fp, std::string_view message) {
+    using K = Keys<Q>;
+    const char* data = message.data();
+    return message.size() >= fp.minSize && detail::numberEnd(data[fp.tBeg + fp.tLen]) &&
+           detail::numberEnd(data[fp.uBeg + fp.uLen]) &&
+           detail::keyAt(message, fp.tBeg - K::t.size(), K::t) &&
+           detail::keyAt(message, fp.uBeg - K::u.size(), K::u) &&
+           (detail::keyAt(message, fp.abBeg - Q, K::bids) ||
+            detail::keyAt(message, fp.abBeg - Q, K::asks));
+}
+
+}   // namespace ozma
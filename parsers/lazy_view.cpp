@@ -0,0 +1,110 @@
+#include "lazy_view.h"
+
+#include "common.h"
+#include "layout.h"
+#include "simd.h"
+
+#include <algorithm>
+#include <cctype>
+#include <charconv>
+
+namespace ozma {
+
+std::span<const Order> BTCUSDTView::Side::top(size_t n) const {
+    n = std::min(n, size_);
+    for (size_t level = 0; level < n; level++) {
+        if (!decoded_.test(level)) {
+            decode(level);
+        }
+    }
+    return std::span<const Order>(orders_.data(), n);
+}
+
+void BTCUSDTView::Side::decode(size_t level) const {
+    if (mode_ == Decode::Scalar) {
+        const char* price = base_ + priceOff_[level];
+        const char* size = base_ + sizeOff_[level];
+        std::from_chars(price, price + priceLen_[level], orders_[level].price);
+        std::from_chars(size, size + sizeLen_[level], orders_[level].size);
+        decoded_.set(level);
+        return;
+    }
+
+    const size_t blockBeg = level / blockSize * blockSize;
+    const size_t blockEnd = std::min(blockBeg + blockSize, size_);
+    alignas(32) std::array<Charset, blockSize * 2> chars{};
+    for (size_t l = blockBeg, charsI = 0; l < blockEnd; l++) {
+        fillCharset(chars[charsI++], base_ + priceOff_[l], priceLen_[l]);
+        fillCharset(chars[charsI++], base_ + sizeOff_[l], sizeLen_[l]);
+    }
+    alignas(32) std::array<float, blockSize * 2> floats;
+    parse8CharsToFloatsAvx(&chars[0], &floats[0]);
+    if (blockEnd - blockBeg > blockSize / 2) {
+        parse8CharsToFloatsAvx(&chars[blockSize], &floats[blockSize]);
+    }
+    for (size_t l = blockBeg, floatsI = 0; l < blockEnd; l++, floatsI += 2) {
+        orders_[l] = Order{ floats[floatsI], floats[floatsI + 1] };
+        decoded_.set(l);
+    }
+}
+
+template <size_t Q>
+void BTCUSDTView::index(std::string_view message, Decode mode) {
+    using L = Layout<Q>;
+
+    std::from_chars(message.data() + L::tBeg, message.data() + L::tBeg + L::len, t_);
+    std::from_chars(message.data() + L::uBeg, message.data() + L::uBeg + L::len, u_);
+
+    for (Side* side : { &asks_, &bids_ }) {
+        side->base_ = message.data();
+        side->mode_ = mode;
+    }
+
+    Side* current = nullptr;
+    for (size_t i = L::abBeg; i < message.size();) {
+        // ab switch //
+        if (!std::isdigit(message[i])) {
+            current = message[i] == 'a' ? &asks_ : &bids_;
+            i += L::abPadding;
+        }
+        REQUIRE(current->size_ < maxLevels, "Too many levels in message");
+        // price //
+        size_t priceLen{};
+        for (; i + priceLen < message.size() && message[i + priceLen] != '\"'; priceLen++) {
+        }
+        current->priceOff_[current->size_] = static_cast<uint32_t>(i);
+        current->priceLen_[current->size_] = static_cast<uint8_t>(priceLen);
+        i += priceLen + L::priceTail;
+        // size //
+        size_t sizeLen{};
+        for (; i + sizeLen < message.size() && message[i + sizeLen] != '\"'; sizeLen++) {
+        }
+        current->sizeOff_[current->size_] = static_cast<uint32_t>(i);
+        current->sizeLen_[current->size_] = static_cast<uint8_t>(sizeLen);
+        i += sizeLen + L::sizeTail;
+        current->size_++;
+    }
+}
+
+BTCUSDTView BTCUSDTView::fromJson(std::string_view message, Decode mode) {
+    BTCUSDTView view;
+    view.index<1>(message, mode);
+    return view;
+}
+
+BTCUSDTView BTCUSDTView::fromEscaped(std::string_view raw, Decode mode) {
+    BTCUSDTView view;
+    view.index<2>(raw, mode);
+    return view;
+}
+
+BTCUSDT BTCUSDTView::materialize(std::pmr::memory_resource* resource) const {
+    BTCUSDT result(BTCUSDT::allocator_type{ resource });
+    result.t = t_;
+    result.u = u_;
+    result.asks.assign(asks_.begin(), asks_.end());
+    result.bids.assign(bids_.begin(), bids_.end());
+    return result;
+}
+
+}   // namespace ozma
@@ -0,0 +1,145 @@
+#pragma once
+
+#include "parser.h"
+
+#include <array>
+#include <bitset>
+#include <cstdint>
+#include <iterator>
+#include <memory_resource>
+#include <span>
+#include <string_view>
+
+namespace ozma {
+
+enum class Decode { Scalar, Avx };
+
+// Lazy BTCUSDT over the message body. Construction reads t/u and indexes level offsets,
+// price/size of a level are decoded the first time it is touched (Avx: by blocks of 8 levels).
+// The view refers to the message memory, which has to outlive it.
+class BTCUSDTView {
+public:
+    constexpr static size_t maxLevels = 128;
+    constexpr static size_t blockSize = 8;
+
+    class Side {
+    public:
+        class Iterator {
+        public:
+            using iterator_category = std::forward_iterator_tag;
+            using value_type = Order;
+            using difference_type = std::ptrdiff_t;
+            using pointer = const Order*;
+            using reference = const Order&;
+
+            Iterator() = default;
+            Iterator(const Side* side, size_t level)
+                : side_(side)
+                , level_(level) {
+            }
+
+            reference operator*() const {
+                return (*side_)[level_];
+            }
+
+            pointer operator->() const {
+                return &(*side_)[level_];
+            }
+
+            Iterator& operator++() {
+                ++level_;
+                return *this;
+            }
+
+            Iterator operator++(int) {
+                Iterator prev = *this;
+                ++level_;
+                return prev;
+            }
+
+            bool operator==(const Iterator& other) const {
+                return level_ == other.level_;
+            }
+
+        private:
+            const Side* side_ = nullptr;
+            size_t level_ = 0;
+        };
+
+        const Order& operator[](size_t level) const {
+            if (!decoded_.test(level)) {
+                decode(level);
+            }
+            return orders_[level];
+        }
+
+        // Decodes only the first n levels
+        std::span<const Order> top(size_t n) const;
+
+        size_t size() const {
+            return size_;
+        }
+
+        bool empty() const {
+            return size_ == 0;
+        }
+
+        Iterator begin() const {
+            return Iterator(this, 0);
+        }
+
+        Iterator end() const {
+            return Iterator(this, size_);
+        }
+
+    private:
+        friend class BTCUSDTView;
+
+        void decode(size_t level) const;
+
+        const char* base_ = nullptr;
+        Decode mode_ = Decode::Avx;
+        size_t size_ = 0;
+        std::array<uint32_t, maxLevels> priceOff_;
+        std::array<uint32_t, maxLevels> sizeOff_;
+        std::array<uint8_t, maxLevels> priceLen_;
+        std::array<uint8_t, maxLevels> sizeLen_;
+        mutable std::bitset<maxLevels> decoded_;
+        mutable std::array<Order, maxLevels> orders_;
+    };
+
+    static BTCUSDTView fromJson(std::string_view message, Decode mode = Decode::Avx);
+    // Body as it is stored in the csv field, see CustomParser::parseEscaped
+    static BTCUSDTView fromEscaped(std::string_view raw, Decode mode = Decode::Avx);
+
+    int64_t t() const {
+        return t_;
+    }
+
+    int64_t u() const {
+        return u_;
+    }
+
+    const Side& asks() const {
+        return asks_;
+    }
+
+    const Side& bids() const {
+        return bids_;
+    }
+
+    // Decodes everything
+    BTCUSDT materialize(
+        std::pmr::memory_resource* resource = std::pmr::get_default_resource()) const;
+
+private:
+    template <size_t Q>
+    void index(std::string_view message, Decode mode);
+
+    int64_t t_{};
+    int64_t u_{};
+    Side asks_;
+    Side bids_;
+};
+
+}   // namespace ozma
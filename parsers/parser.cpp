@@ -1,12 +1,14 @@
 #include "parser.h"
 #include "benchmark.h"
+#include "layout.h"
+#include "simd.h"
 #include "common.h"
+#include <algorithm>
 #include <cctype>
 #include <charconv>
 #include <chrono>
 #include <cstdint>
 #include <cstring>
-#include <immintrin.h>
 #include <iostream>
 #include <stddef.h>
 #include <stdint.h>
@@ -16,19 +18,18 @@
 
 #include "logger.h"
 #include "nlohmann/json.hpp"
-#include "simdjson/include/simdjson.h"
 
 namespace ozma {
 
-BTCUSDT NlohmannJsonParser::parse(const std::string& message) {
-    BTCUSDT result;
+void NlohmannJsonParser::parse(const std::string& message, BTCUSDT& result) {
     nlohmann::json jsonData = nlohmann::json::parse(message);
 
     result.t = jsonData.at("T").get<int64_t>();
     result.u = jsonData.at("u").get<int64_t>();
+    result.asks.clear();
+    result.bids.clear();
 
-    auto parseOrders = [](const nlohmann::json& data) -> std::vector<Order> {
-        std::vector<Order> orders;
+    auto parseOrders = [](const nlohmann::json& data, Orders& orders) {
         orders.reserve(64);
         for (const auto& item : data) {
             auto priceStr = item[0].get<std::string_view>();
@@ -39,29 +40,44 @@ BTCUSDT NlohmannJsonParser::parse(const std::string& message) {
             std::from_chars(sizeStr.begin(), sizeStr.end(), size);
             orders.emplace_back(Order{ price, size });
         }
-        return orders;
     };
 
     if (auto finder = jsonData.find("a"); finder != jsonData.end()) {
-        result.asks = parseOrders(*finder);
+        parseOrders(*finder, result.asks);
     }
     if (auto finder = jsonData.find("b"); finder != jsonData.end()) {
-        result.bids = parseOrders(*finder);
+        parseOrders(*finder, result.bids);
     }
-    return result;
 }
 
-BTCUSDT SimdJsonParser::parse(const std::string& message) {
-    BTCUSDT result;
-    simdjson::ondemand::parser parser;
-    simdjson::padded_string jsonPadded = simdjson::padded_string(message);
-    simdjson::ondemand::document doc = parser.iterate(jsonPadded);
+const BTCUSDT& NlohmannJsonParser::parse(const std::string& message) {
+    parse(message, result_);
+    return result_;
+}
+
+void SimdJsonParser::parse(const std::string& message, BTCUSDT& result) {
+    // simdjson reads up to SIMDJSON_PADDING bytes past the end, the string's own spare
+    // capacity is enough most of the time, otherwise the message goes to the scratch buffer
+    const char* json = message.data();
+    size_t capacity = message.capacity();
+    if (capacity - message.size() < simdjson::SIMDJSON_PADDING) {
+        const size_t required = message.size() + simdjson::SIMDJSON_PADDING;
+        if (scratchCapacity_ < required) {
+            scratch_ = std::make_unique<char[]>(required);
+            scratchCapacity_ = required;
+        }
+        std::memcpy(scratch_.get(), message.data(), message.size());
+        json = scratch_.get();
+        capacity = scratchCapacity_;
+    }
+    simdjson::ondemand::document doc = parser_.iterate(json, message.size(), capacity);
 
     result.t = doc["T"];
     result.u = doc["u"];
+    result.asks.clear();
+    result.bids.clear();
 
-    auto parseOrders = [](simdjson::ondemand::array ordersArray) -> std::vector<Order> {
-        std::vector<Order> orders;
+    auto parseOrders = [](simdjson::ondemand::array ordersArray, Orders& orders) {
         orders.reserve(64);
         for (auto orderElem : ordersArray) {
             simdjson::ondemand::array orderArray = orderElem.get_array();
@@ -76,138 +92,94 @@ BTCUSDT SimdJsonParser::parse(const std::string& message) {
 
             orders.emplace_back(Order{ price, size });
         }
-        return orders;
     };
 
     if (auto finder = doc.find_field_unordered("a"); finder.error() == simdjson::SUCCESS) {
-        result.asks = parseOrders(finder);
+        parseOrders(finder, result.asks);
     }
     if (auto finder = doc.find_field_unordered("b"); finder.error() == simdjson::SUCCESS) {
-        result.bids = parseOrders(finder);
+        parseOrders(finder, result.bids);
     }
-    return result;
 }
 
-BTCUSDT CustomParser::parse(const std::string& message) {
-    constexpr static size_t tBeg = 41;
-    constexpr static size_t uBeg = 91;
-    constexpr static size_t len = 13;
-    constexpr static size_t abBeg = 125;
-    constexpr static size_t abPadding = 6;
+const BTCUSDT& SimdJsonParser::parse(const std::string& message) {
+    parse(message, result_);
+    return result_;
+}
+
+namespace {
 
-    BTCUSDT result;
-    std::from_chars(message.c_str() + tBeg, message.c_str() + tBeg + len, result.t);
-    std::from_chars(message.c_str() + uBeg, message.c_str() + uBeg + len, result.u);
+// Levels starting at the first side key ('a' or 'b') at abBeg
+template <size_t Q>
+void parseCustomLevels(std::string_view message, size_t abBeg, BTCUSDT& result) {
+    using L = Layout<Q>;
+
+    result.asks.clear();
+    result.bids.clear();
 
     // "b":[["65545.34","0.420"],["65344.2","0.006"],["65548.35","15.034"],["65549.35","5.034"]],"a":[[...]]
-    std::vector<Order>* current = nullptr;
+    Orders* current = nullptr;
     for (size_t i = abBeg; i < message.size();) {
         // ab switch //
         if (!std::isdigit(message[i])) {
             current = message[i] == 'a' ? &result.asks : &result.bids;
             current->reserve(64);
-            i += abPadding;
+            i += L::abPadding;
         }
         // price //
         size_t priceLen{};
         for (; i + priceLen < message.size() && message[i + priceLen] != '\"'; priceLen++) {
         }
         float price{};
-        std::from_chars(message.c_str() + i, message.c_str() + i + priceLen, price);
-        i += priceLen + 3;
+        std::from_chars(message.data() + i, message.data() + i + priceLen, price);
+        i += priceLen + L::priceTail;
         // size //
         size_t sizeLen{};
         for (; i + sizeLen < message.size() && message[i + sizeLen] != '\"'; sizeLen++) {
         }
         float size{};
-        std::from_chars(message.c_str() + i, message.c_str() + i + sizeLen, size);
-        i += sizeLen + 5;
+        std::from_chars(message.data() + i, message.data() + i + sizeLen, size);
+        i += sizeLen + L::sizeTail;
         // emplace //
         current->emplace_back(Order{ price, size });
     }
-    return result;
 }
 
-struct Charset {
-    char set[8]{ 0, 0, 0, 0, 0, 0, 0, 0 };
-};
-
-/*
-    Original article: http://0x80.pl/articles/simd-parsing-int-sequences.html#id19
-
-    Example:
-    input data:
-    d4bit32[0]: "64833250","64833250","64833250""64833250"
-    d4bit32[1]: "00000050","00833250","00003250""00000250"
-
-    converting:
-    1. 1c8bits	32: ['6','4','8','3','3','2','5','0'...] : _mm256_subs_epu8('0');
-    2. 1d8bits	32: [6, 4, 8, 3, 3, 2, 5, 0...] : _mm256_maddubs_epi16 [10, 1, 10, 1...]
-    3. 2d16bit	16: [64, 83, 32, 50...] : vec_mult_add_to_32 [100, 1, 100, 1...]
-    4. 4d32bit	8:  [6483, 3250...] : _mm256_packus_epi32 [e, e...] <- from d4bit32[1]
-    5. 4d16bit	16: [6483, 3250...] shuffled after pack
-
-        _mm256_packus_epi32(left, right)
-        left:   8 32bit numbers:    [a,a,b,b,c,c,d,d]
-        right:  8 32bit numbers:    [e,e,f,f,g,g,h,h]
-        sum:    16 16bit numbers:   [a,a,b,b,e,e,f,f,c,c,d,d,g,g,h,h]
-
-                                                        : _mm256_madd_epi16 [10'000, 1...]
-
-    6. 8d32bit	8:  [a,b,e,f,c,d,g,h] : _mm256_cvtepi32_ps
-    7. 8f32bit  8:  [af,bf,ef,ff,cf,df,gf,hf] : _mm256_div_ps [100.f, 1000.f...]
-    8. 8f32bit (prices with 2 fraction digints; sizes with 3 fraction digits)
-    9. deshuffle
-*/
-std::array<float, 256> parseCharsToFloatsAvx(std::array<Charset, 256>& chars, size_t size) {
-    std::array<float, 256> result;
-    for (size_t i = 0, resI = 0;; i += 8) {
-        __m256i d4bit32[2]{};
-        for (size_t s = 0; s < 2; s++) {
-            __m256i rawChars = _mm256_loadu_si256(reinterpret_cast<__m256i*>(&chars[i + s * 4]));
-            const __m256i ascii0 = _mm256_set1_epi8('0');
-            __m256i d1bit8 = _mm256_subs_epu8(rawChars, ascii0);
-
-            const __m256i mult10 = _mm256_setr_epi8(
-                10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1,
-                10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1);
-            __m256i d2bit16 = _mm256_maddubs_epi16(d1bit8, mult10);
-
-            const __m256i mult100 = _mm256_setr_epi16(
-                100, 1, 100, 1, 100, 1, 100, 1, 100, 1, 100, 1, 100, 1, 100, 1);
-            d4bit32[s] = _mm256_madd_epi16(d2bit16, mult100);
-        }
-        __m256i d4bit16 = _mm256_packus_epi32(d4bit32[0], d4bit32[1]);
+template <size_t Q>
+void parseCustom(std::string_view message, BTCUSDT& result) {
+    using L = Layout<Q>;
 
-        const __m256i mult10k = _mm256_setr_epi16(
-            10'000, 1, 10'000, 1, 10'000, 1, 10'000, 1, 10'000, 1, 10'000, 1, 10'000, 1, 10'000, 1);
-        __m256i d8bit32 = _mm256_madd_epi16(d4bit16, mult10k);
+    std::from_chars(message.data() + L::tBeg, message.data() + L::tBeg + L::len, result.t);
+    std::from_chars(message.data() + L::uBeg, message.data() + L::uBeg + L::len, result.u);
+    parseCustomLevels<Q>(message, L::abBeg, result);
+}
 
-        __m256 f8bit32 = _mm256_cvtepi32_ps(d8bit32);
+}   // namespace
 
-        const __m256 divMask =
-            _mm256_setr_ps(100.f, 1000.f, 100.f, 1000.f, 100.f, 1000.f, 100.f, 1000.f);
-        __m256 f8Shuffled = _mm256_div_ps(f8bit32, divMask);
-        for (size_t j : {0, 1, 4, 5, 2, 3, 6, 7}) {
-            result[resI++] = f8Shuffled[j];
-        }
-        if (i >= size) {
-            break;
-        }
-    }
-    return result;
+void CustomParser::parse(const std::string& message, BTCUSDT& result) {
+    parseCustom<1>(message, result);
+}
+
+void CustomParser::parseEscaped(std::string_view raw, BTCUSDT& result) {
+    parseCustom<2>(raw, result);
 }
 
-BTCUSDT CustomAvxParser::parse(const std::string& message) {
-    constexpr static size_t tBeg = 41;
-    constexpr static size_t uBeg = 91;
-    constexpr static size_t len = 13;
-    constexpr static size_t abBeg = 125;
-    constexpr static size_t abPadding = 6;
+const BTCUSDT& CustomParser::parse(const std::string& message) {
+    parseCustom<1>(message, result_);
+    return result_;
+}
+
+const BTCUSDT& CustomParser::parseEscaped(std::string_view raw) {
+    parseCustom<2>(raw, result_);
+    return result_;
+}
 
-    BTCUSDT result;
-    std::from_chars(message.c_str() + tBeg, message.c_str() + tBeg + len, result.t);
-    std::from_chars(message.c_str() + uBeg, message.c_str() + uBeg + len, result.u);
+namespace {
+
+// Levels starting at the first side key ('a' or 'b') at abBeg
+template <size_t Q>
+void parseCustomAvxLevels(std::string_view message, size_t abBeg, BTCUSDT& result) {
+    using L = Layout<Q>;
 
     char order[2]{ 0, 0 };
     size_t orderI = 0;
@@ -219,7 +191,7 @@ BTCUSDT CustomAvxParser::parse(const std::string& message) {
         if (!std::isdigit(message[i])) {
             order[orderI++] = message[i];
             sideLen[0] = charsI;
-            i += abPadding;
+            i += L::abPadding;
         }
         // price //
         size_t priceLen{};
@@ -231,7 +203,7 @@ BTCUSDT CustomAvxParser::parse(const std::string& message) {
             }
         }
         charsI++;
-        i += priceLen + 3;
+        i += priceLen + L::priceTail;
         // size //
         size_t sizeLen{};
         for (; i + sizeLen < message.size() && message[i + sizeLen] != '\"'; sizeLen++) {
@@ -242,7 +214,7 @@ BTCUSDT CustomAvxParser::parse(const std::string& message) {
             }
         }
         charsI++;
-        i += sizeLen + 5;
+        i += sizeLen + L::sizeTail;
     }
     if (sideLen[0] == 0) {
         sideLen[0] = charsI;
@@ -252,9 +224,11 @@ BTCUSDT CustomAvxParser::parse(const std::string& message) {
 
     auto floats = parseCharsToFloatsAvx(chars, charsI);
 
+    result.asks.clear();
+    result.bids.clear();
     size_t floatsI = 0;
     for (size_t oI = 0; oI < 2; oI++) {
-        std::vector<Order>* current = nullptr;
+        Orders* current = nullptr;
         if (order[oI] == 'a') {
             current = &result.asks;
         } else if (order[oI] == 'b') {
@@ -268,7 +242,82 @@ BTCUSDT CustomAvxParser::parse(const std::string& message) {
             (*current)[i].size = floats[floatsI + 1];
         }
     }
-    return result;
+}
+
+template <size_t Q>
+void parseCustomAvx(std::string_view message, BTCUSDT& result) {
+    using L = Layout<Q>;
+
+    std::from_chars(message.data() + L::tBeg, message.data() + L::tBeg + L::len, result.t);
+    std::from_chars(message.data() + L::uBeg, message.data() + L::uBeg + L::len, result.u);
+    parseCustomAvxLevels<Q>(message, L::abBeg, result);
+}
+
+}   // namespace
+
+void CustomAvxParser::parse(const std::string& message, BTCUSDT& result) {
+    parseCustomAvx<1>(message, result);
+}
+
+void CustomAvxParser::parseEscaped(std::string_view raw, BTCUSDT& result) {
+    parseCustomAvx<2>(raw, result);
+}
+
+const BTCUSDT& CustomAvxParser::parse(const std::string& message) {
+    parseCustomAvx<1>(message, result_);
+    return result_;
+}
+
+const BTCUSDT& CustomAvxParser::parseEscaped(std::string_view raw) {
+    parseCustomAvx<2>(raw, result_);
+    return result_;
+}
+
+template <size_t Q>
+const Fingerprint& FingerprintParser::fingerprint(std::string_view message, int32_t id) {
+    auto it = std::find_if(cache_.begin(), cache_.end(), [id](const Entry& entry) {
+        return entry.id == id && entry.q == Q;
+    });
+    if (it != cache_.end() && matchesFingerprint<Q>(it->fingerprint, message)) {
+        return it->fingerprint;
+    }
+
+    auto learned = learnFingerprint<Q>(message);
+    REQUIRE(learned, "Unknown message layout, id " << id << ": " << message);
+    learned_++;
+    if (it == cache_.end()) {
+        cache_.push_back(Entry{ id, Q, *learned });
+        return cache_.back().fingerprint;
+    }
+    it->fingerprint = *learned;
+    return it->fingerprint;
+}
+
+template <size_t Q>
+void FingerprintParser::parseWith(std::string_view message, int32_t id, BTCUSDT& result) {
+    const Fingerprint& fp = fingerprint<Q>(message, id);
+    const char* data = message.data();
+    std::from_chars(data + fp.tBeg, data + fp.tBeg + fp.tLen, result.t);
+    std::from_chars(data + fp.uBeg, data + fp.uBeg + fp.uLen, result.u);
+    parseCustomAvxLevels<Q>(message, fp.abBeg, result);
+}
+
+void FingerprintParser::parse(const std::string& message, int32_t id, BTCUSDT& result) {
+    parseWith<1>(message, id, result);
+}
+
+void FingerprintParser::parseEscaped(std::string_view raw, int32_t id, BTCUSDT& result) {
+    parseWith<2>(raw, id, result);
+}
+
+const BTCUSDT& FingerprintParser::parse(const std::string& message, int32_t id) {
+    parseWith<1>(message, id, result_);
+    return result_;
+}
+
+const BTCUSDT& FingerprintParser::parseEscaped(std::string_view raw, int32_t id) {
+    parseWith<2>(raw, id, result_);
+    return result_;
 }
 
 }   // namespace ozma
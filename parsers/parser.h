@@ -1,10 +1,16 @@
 #pragma once
 
 #include "common.h"
+#include "layout.h"
+#include <memory>
+#include <memory_resource>
 #include <sstream>
 #include <string>
+#include <string_view>
 #include <vector>
 
+#include "simdjson/include/simdjson.h"
+
 namespace ozma {
 
 enum class Parsing { Custom };
@@ -15,13 +21,52 @@ struct Order {
     float size{};
 };
 
+using Orders = std::pmr::vector<Order>;
+
+// Levels are allocated from the given memory resource (e.g. a batch Arena), default heap otherwise
 struct BTCUSDT {
+    using allocator_type = std::pmr::polymorphic_allocator<Order>;
+
     static inline int32_t iD1 = 256;
     static inline int32_t iD2 = 257;
+
+    BTCUSDT() = default;
+    BTCUSDT(const BTCUSDT&) = default;
+    BTCUSDT(BTCUSDT&&) = default;
+    BTCUSDT& operator=(const BTCUSDT&) = default;
+    BTCUSDT& operator=(BTCUSDT&&) = default;
+
+    explicit BTCUSDT(const allocator_type& alloc)
+        : asks(alloc)
+        , bids(alloc) {
+    }
+
+    BTCUSDT(const BTCUSDT& other, const allocator_type& alloc)
+        : t(other.t)
+        , u(other.u)
+        , asks(other.asks, alloc)
+        , bids(other.bids, alloc) {
+    }
+
+    BTCUSDT(BTCUSDT&& other, const allocator_type& alloc)
+        : t(other.t)
+        , u(other.u)
+        , asks(std::move(other.asks), alloc)
+        , bids(std::move(other.bids), alloc) {
+    }
+
+    // Level storage as well, for CachePressure
+    template <typename Visit>
+    void visitBuffers(Visit&& visit) const {
+        visit(this, sizeof(*this));
+        visit(asks.data(), asks.capacity() * sizeof(Order));
+        visit(bids.data(), bids.capacity() * sizeof(Order));
+    }
+
     int64_t t{};
     int64_t u{};
-    std::vector<Order> asks;
-    std::vector<Order> bids;
+    Orders asks;
+    Orders bids;
 };
 
 inline std::stringstream& operator<<(std::stringstream& ss, BTCUSDT btc) {
@@ -37,24 +82,121 @@ inline std::stringstream& operator<<(std::stringstream& ss, BTCUSDT btc) {
     return ss;
 }
 
+// Parsers are per-thread contexts: internal buffers and the output are reused between calls.
+// The reference returned by parse() stays valid until the next call.
+
 class NlohmannJsonParser {
 public:
-    static BTCUSDT parse(const std::string& message);
+    const BTCUSDT& parse(const std::string& message);
+    void parse(const std::string& message, BTCUSDT& result);
+
+    template <typename Visit>
+    void visitBuffers(Visit&& visit) const {
+        visit(this, sizeof(*this));
+        result_.visitBuffers(visit);
+    }
+
+private:
+    BTCUSDT result_;
 };
 
 class SimdJsonParser {
 public:
-    static BTCUSDT parse(const std::string& message);
+    const BTCUSDT& parse(const std::string& message);
+    void parse(const std::string& message, BTCUSDT& result);
+
+    // simdjson keeps its internal buffers private: only the scratch copy and the output
+    template <typename Visit>
+    void visitBuffers(Visit&& visit) const {
+        visit(this, sizeof(*this));
+        visit(scratch_.get(), scratchCapacity_);
+        result_.visitBuffers(visit);
+    }
+
+private:
+    simdjson::ondemand::parser parser_;
+    // Padded copy of the message, grows up to the largest message seen
+    std::unique_ptr<char[]> scratch_;
+    size_t scratchCapacity_ = 0;
+    BTCUSDT result_;
 };
 
 class CustomParser {
 public:
-    static BTCUSDT parse(const std::string& message);
+    const BTCUSDT& parse(const std::string& message);
+    void parse(const std::string& message, BTCUSDT& result);
+    // Body as it is stored in the csv field (without outer quotes), '"' is escaped as ""
+    const BTCUSDT& parseEscaped(std::string_view raw);
+    void parseEscaped(std::string_view raw, BTCUSDT& result);
+
+    template <typename Visit>
+    void visitBuffers(Visit&& visit) const {
+        visit(this, sizeof(*this));
+        result_.visitBuffers(visit);
+    }
+
+private:
+    BTCUSDT result_;
 };
 
 class CustomAvxParser {
 public:
-    static BTCUSDT parse(const std::string& message);
+    const BTCUSDT& parse(const std::string& message);
+    void parse(const std::string& message, BTCUSDT& result);
+    // Body as it is stored in the csv field (without outer quotes), '"' is escaped as ""
+    const BTCUSDT& parseEscaped(std::string_view raw);
+    void parseEscaped(std::string_view raw, BTCUSDT& result);
+
+    template <typename Visit>
+    void visitBuffers(Visit&& visit) const {
+        visit(this, sizeof(*this));
+        result_.visitBuffers(visit);
+    }
+
+private:
+    BTCUSDT result_;
+};
+
+// Fixed-offset parsing with the offsets learned from the first message of each id instead of
+// hardcoded. Every message only has a few sentinel bytes checked, a mismatch relearns the layout.
+class FingerprintParser {
+public:
+    const BTCUSDT& parse(const std::string& message, int32_t id);
+    void parse(const std::string& message, int32_t id, BTCUSDT& result);
+    // Body as it is stored in the csv field (without outer quotes), '"' is escaped as ""
+    const BTCUSDT& parseEscaped(std::string_view raw, int32_t id);
+    void parseEscaped(std::string_view raw, int32_t id, BTCUSDT& result);
+
+    // Times a layout was learned, the first message of each id included
+    size_t learned() const {
+        return learned_;
+    }
+
+    template <typename Visit>
+    void visitBuffers(Visit&& visit) const {
+        visit(this, sizeof(*this));
+        visit(cache_.data(), cache_.capacity() * sizeof(Entry));
+        result_.visitBuffers(visit);
+    }
+
+private:
+    struct Entry {
+        int32_t id;
+        // Quote width the offsets are for
+        size_t q;
+        Fingerprint fingerprint;
+    };
+
+    template <size_t Q>
+    const Fingerprint& fingerprint(std::string_view message, int32_t id);
+
+    template <size_t Q>
+    void parseWith(std::string_view message, int32_t id, BTCUSDT& result);
+
+    // A handful of ids: linear search beats hashing
+    std::vector<Entry> cache_;
+    size_t learned_ = 0;
+    BTCUSDT result_;
 };
 
 }   // namespace ozma
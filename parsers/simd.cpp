@@ -0,0 +1,74 @@
+#include "simd.h"
+
+#include <immintrin.h>
+
+namespace ozma {
+
+/*
+    Original article: http://0x80.pl/articles/simd-parsing-int-sequences.html#id19
+
+    Example:
+    input data:
+    d4bit32[0]: "64833250","64833250","64833250""64833250"
+    d4bit32[1]: "00000050","00833250","00003250""00000250"
+
+    converting:
+    1. 1c8bits	32: ['6','4','8','3','3','2','5','0'...] : _mm256_subs_epu8('0');
+    2. 1d8bits	32: [6, 4, 8, 3, 3, 2, 5, 0...] : _mm256_maddubs_epi16 [10, 1, 10, 1...]
+    3. 2d16bit	16: [64, 83, 32, 50...] : vec_mult_add_to_32 [100, 1, 100, 1...]
+    4. 4d32bit	8:  [6483, 3250...] : _mm256_packus_epi32 [e, e...] <- from d4bit32[1]
+    5. 4d16bit	16: [6483, 3250...] shuffled after pack
+
+        _mm256_packus_epi32(left, right)
+        left:   8 32bit numbers:    [a,a,b,b,c,c,d,d]
+        right:  8 32bit numbers:    [e,e,f,f,g,g,h,h]
+        sum:    16 16bit numbers:   [a,a,b,b,e,e,f,f,c,c,d,d,g,g,h,h]
+
+                                                        : _mm256_madd_epi16 [10'000, 1...]
+
+    6. 8d32bit	8:  [a,b,e,f,c,d,g,h] : _mm256_cvtepi32_ps
+    7. 8f32bit  8:  [af,bf,ef,ff,cf,df,gf,hf] : _mm256_div_ps [100.f, 1000.f...]
+    8. 8f32bit (prices with 2 fraction digints; sizes with 3 fraction digits)
+    9. deshuffle
+*/
+void parse8CharsToFloatsAvx(const Charset* chars, float* out) {
+    __m256i d4bit32[2]{};
+    for (size_t s = 0; s < 2; s++) {
+        __m256i rawChars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(&chars[s * 4]));
+        const __m256i ascii0 = _mm256_set1_epi8('0');
+        __m256i d1bit8 = _mm256_subs_epu8(rawChars, ascii0);
+
+        const __m256i mult10 = _mm256_setr_epi8(
+            10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1,
+            10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1, 10, 1);
+        __m256i d2bit16 = _mm256_maddubs_epi16(d1bit8, mult10);
+
+        const __m256i mult100 = _mm256_setr_epi16(
+            100, 1, 100, 1, 100, 1, 100, 1, 100, 1, 100, 1, 100, 1, 100, 1);
+        d4bit32[s] = _mm256_madd_epi16(d2bit16, mult100);
+    }
+    __m256i d4bit16 = _mm256_packus_epi32(d4bit32[0], d4bit32[1]);
+
+    const __m256i mult10k = _mm256_setr_epi16(
+        10'000, 1, 10'000, 1, 10'000, 1, 10'000, 1, 10'000, 1, 10'000, 1, 10'000, 1, 10'000, 1);
+    __m256i d8bit32 = _mm256_madd_epi16(d4bit16, mult10k);
+
+    __m256 f8bit32 = _mm256_cvtepi32_ps(d8bit32);
+
+    const __m256 divMask =
+        _mm256_setr_ps(100.f, 1000.f, 100.f, 1000.f, 100.f, 1000.f, 100.f, 1000.f);
+    __m256 f8Shuffled = _mm256_div_ps(f8bit32, divMask);
+
+    const __m256i deshuffle = _mm256_setr_epi32(0, 1, 4, 5, 2, 3, 6, 7);
+    _mm256_storeu_ps(out, _mm256_permutevar8x32_ps(f8Shuffled, deshuffle));
+}
+
+std::array<float, 256> parseCharsToFloatsAvx(std::array<Charset, 256>& chars, size_t size) {
+    std::array<float, 256> result;
+    for (size_t i = 0; i < size; i += 8) {
+        parse8CharsToFloatsAvx(&chars[i], &result[i]);
+    }
+    return result;
+}
+
+}   // namespace ozma
@@ -0,0 +1,26 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+
+namespace ozma {
+
+// Number right-aligned in 8 chars without the dot, leading chars are zeroes
+struct Charset {
+    char set[8]{ 0, 0, 0, 0, 0, 0, 0, 0 };
+};
+
+inline void fillCharset(Charset& charset, const char* beg, size_t len) {
+    for (size_t backI = len, setI = 8; backI > 0 && setI > 0; backI--) {
+        if (beg[backI - 1] != '.') {
+            charset.set[--setI] = beg[backI - 1];
+        }
+    }
+}
+
+// 8 charsets [price, size, price, size...] -> 8 floats in the same order
+void parse8CharsToFloatsAvx(const Charset* chars, float* out);
+
+std::array<float, 256> parseCharsToFloatsAvx(std::array<Charset, 256>& chars, size_t size);
+
+}   // namespace ozma
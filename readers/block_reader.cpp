@@ -0,0 +1,271 @@
+#include "block_reader.h"
+
+#include "common.h"
+
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace ozma {
+
+namespace {
+
+const size_t PAGE_SIZE = 4096;
+
+}   // namespace
+
+// Minimal io_uring over raw syscalls: one producer, one consumer, read requests only
+class Uring {
+public:
+    explicit Uring(unsigned entries) {
+        io_uring_params params{};
+        fd_ = static_cast<int>(syscall(__NR_io_uring_setup, entries, &params));
+        if (fd_ < 0) {
+            return;
+        }
+        sqRingSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+        cqRingSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+        const bool singleMmap = params.features & IORING_FEAT_SINGLE_MMAP;
+        if (singleMmap) {
+            sqRingSize_ = cqRingSize_ = std::max(sqRingSize_, cqRingSize_);
+        }
+        sqRing_ = mapRing(sqRingSize_, IORING_OFF_SQ_RING);
+        cqRing_ = singleMmap ? sqRing_ : mapRing(cqRingSize_, IORING_OFF_CQ_RING);
+        sqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+        sqes_ = static_cast<io_uring_sqe*>(mapRing(sqesSize_, IORING_OFF_SQES));
+        if (sqRing_ == nullptr || cqRing_ == nullptr || sqes_ == nullptr) {
+            release();
+            return;
+        }
+
+        auto* sq = static_cast<char*>(sqRing_);
+        sqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+        sqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+        sqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+        auto* cq = static_cast<char*>(cqRing_);
+        cqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+        cqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+        cqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+        cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    }
+
+    ~Uring() {
+        release();
+    }
+
+    bool valid() const {
+        return fd_ >= 0;
+    }
+
+    bool read(int fd, char* data, size_t len, uint64_t offset, uint64_t userData) {
+        const unsigned tail = *sqTail_;
+        const unsigned idx = tail & sqMask_;
+        io_uring_sqe& sqe = sqes_[idx];
+        std::memset(&sqe, 0, sizeof(sqe));
+        sqe.opcode = IORING_OP_READ;
+        sqe.fd = fd;
+        sqe.addr = reinterpret_cast<uint64_t>(data);
+        sqe.len = static_cast<uint32_t>(len);
+        sqe.off = offset;
+        sqe.user_data = userData;
+        sqArray_[idx] = idx;
+        std::atomic_ref<unsigned>(*sqTail_).store(tail + 1, std::memory_order_release);
+        return syscall(__NR_io_uring_enter, fd_, 1, 0, 0, nullptr, 0) == 1;
+    }
+
+    // Blocks until a completion is available
+    io_uring_cqe wait() {
+        for (;;) {
+            const unsigned head = *cqHead_;
+            if (head != std::atomic_ref<unsigned>(*cqTail_).load(std::memory_order_acquire)) {
+                const io_uring_cqe cqe = cqes_[head & cqMask_];
+                std::atomic_ref<unsigned>(*cqHead_).store(head + 1, std::memory_order_release);
+                return cqe;
+            }
+            const auto res =
+                syscall(__NR_io_uring_enter, fd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+            REQUIRE(res >= 0 || errno == EINTR, "io_uring_enter error: " << std::strerror(errno));
+        }
+    }
+
+private:
+    void* mapRing(size_t size, uint64_t offset) {
+        void* ptr = mmap(
+            nullptr,
+            size,
+            PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_POPULATE,
+            fd_,
+            static_cast<off_t>(offset));
+        return ptr == MAP_FAILED ? nullptr : ptr;
+    }
+
+    void release() {
+        if (sqes_) {
+            munmap(sqes_, sqesSize_);
+        }
+        if (cqRing_ && cqRing_ != sqRing_) {
+            munmap(cqRing_, cqRingSize_);
+        }
+        if (sqRing_) {
+            munmap(sqRing_, sqRingSize_);
+        }
+        sqes_ = nullptr;
+        cqRing_ = sqRing_ = nullptr;
+        if (fd_ >= 0) {
+            close(fd_);
+            fd_ = -1;
+        }
+    }
+
+    int fd_ = -1;
+    void* sqRing_ = nullptr;
+    void* cqRing_ = nullptr;
+    size_t sqRingSize_ = 0;
+    size_t cqRingSize_ = 0;
+    size_t sqesSize_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    unsigned* sqTail_ = nullptr;
+    unsigned sqMask_ = 0;
+    unsigned* sqArray_ = nullptr;
+    unsigned* cqHead_ = nullptr;
+    unsigned* cqTail_ = nullptr;
+    unsigned cqMask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+};
+
+BlockReader::BlockReader(
+    const std::string& path, size_t blockSize, size_t blocks, bool useUring, int node)
+    : path_(path)
+    , blockSize_((blockSize + PAGE_SIZE - 1) / PAGE_SIZE * PAGE_SIZE)
+    , buffers_(blocks)
+    , current_(blocks) {
+    REQUIRE(blocks >= 2, "At least two buffers are needed to overlap reads");
+    fd_ = open(path_.c_str(), O_RDONLY);
+    REQUIRE(fd_ != -1, "Can't open " << path_);
+    struct stat st {};
+    REQUIRE(fstat(fd_, &st) == 0, "Can't stat " << path_);
+    fileSize_ = static_cast<uint64_t>(st.st_size);
+    posix_fadvise(fd_, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    const size_t bytes = blockSize_ * blocks;
+    memory_ = std::unique_ptr<char, NodeFree>(
+        static_cast<char*>(allocOnNode(bytes, node)), NodeFree{ bytes });
+    for (size_t i = 0; i < blocks; i++) {
+        buffers_[i].data = memory_.get() + i * blockSize_;
+    }
+
+    if (useUring) {
+        uring_ = std::make_unique<Uring>(static_cast<unsigned>(blocks));
+        if (!uring_->valid()) {
+            uring_.reset();
+        }
+    }
+    for (size_t i = 0; i < blocks; i++) {
+        submit(i);
+    }
+}
+
+BlockReader::~BlockReader() {
+    // The kernel must not write into freed buffers
+    for (size_t i = 0; i < buffers_.size(); i++) {
+        if (buffers_[i].queued) {
+            wait(i);
+        }
+    }
+    uring_.reset();
+    close(fd_);
+}
+
+std::string_view BlockReader::next() {
+    size_t target = 0;
+    if (current_ < buffers_.size()) {
+        submit(current_);
+        target = (current_ + 1) % buffers_.size();
+    }
+    Buffer& buffer = buffers_[target];
+    if (!buffer.inFlight) {
+        return {};
+    }
+    wait(target);
+    current_ = target;
+    delivered_ = buffer.offset + buffer.len;
+    return std::string_view(buffer.data, buffer.len);
+}
+
+void BlockReader::submit(size_t i) {
+    Buffer& buffer = buffers_[i];
+    buffer.inFlight = false;
+    buffer.queued = false;
+    buffer.ready = false;
+    if (submitOffset_ >= fileSize_) {
+        return;
+    }
+    buffer.offset = submitOffset_;
+    buffer.len = std::min<uint64_t>(blockSize_, fileSize_ - submitOffset_);
+    buffer.inFlight = true;
+    submitOffset_ += buffer.len;
+
+    if (uring_ && uring_->read(fd_, buffer.data, buffer.len, buffer.offset, i)) {
+        buffer.queued = true;
+        return;
+    }
+    // pread fallback: let the kernel read ahead while the consumer is busy
+    posix_fadvise(
+        fd_,
+        static_cast<off_t>(buffer.offset),
+        static_cast<off_t>(buffer.len),
+        POSIX_FADV_WILLNEED);
+}
+
+void BlockReader::wait(size_t i) {
+    Buffer& buffer = buffers_[i];
+    if (buffer.ready) {
+        // completed out of order while waiting for another buffer
+        return;
+    }
+    if (!buffer.queued) {
+        // never went to io_uring
+        readFully(buffer.data, buffer.len, buffer.offset);
+        buffer.ready = true;
+        return;
+    }
+    while (!buffer.ready) {
+        const io_uring_cqe cqe = uring_->wait();
+        Buffer& done = buffers_[cqe.user_data];
+        done.queued = false;
+        done.ready = true;
+        if (cqe.res == -EINVAL || cqe.res == -EOPNOTSUPP) {
+            // kernel without IORING_OP_READ
+            readFully(done.data, done.len, done.offset);
+            continue;
+        }
+        REQUIRE(cqe.res >= 0, "io_uring read error: " << std::strerror(-cqe.res));
+        const auto res = static_cast<size_t>(cqe.res);
+        if (res < done.len) {
+            // short read, complete it synchronously
+            readFully(done.data + res, done.len - res, done.offset + res);
+        }
+    }
+}
+
+void BlockReader::readFully(char* data, size_t len, uint64_t offset) const {
+    while (len > 0) {
+        const ssize_t res = pread(fd_, data, len, static_cast<off_t>(offset));
+        if (res < 0 && errno == EINTR) {
+            continue;
+        }
+        REQUIRE(res > 0, "pread error on " << path_ << ": " << std::strerror(errno));
+        data += res;
+        len -= static_cast<size_t>(res);
+        offset += static_cast<uint64_t>(res);
+    }
+}
+
+}   // namespace ozma
@@ -0,0 +1,77 @@
+#pragma once
+
+#include "topology.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ozma {
+
+class Uring;
+
+// Reads the file in order through a fixed ring of aligned buffers. While the consumer works on
+// one block the others are being read: by io_uring, or by pread with kernel readahead hints
+// when io_uring is not available. Memory footprint is blockSize * blocks regardless of file size.
+class BlockReader {
+public:
+    constexpr static size_t defaultBlockSize = 4 << 20;
+    constexpr static size_t defaultBlocks = 4;
+
+    // node: numa node of the consumer thread for the buffers, negative: not bound
+    explicit BlockReader(
+        const std::string& path,
+        size_t blockSize = defaultBlockSize,
+        size_t blocks = defaultBlocks,
+        bool useUring = true,
+        int node = -1);
+    ~BlockReader();
+
+    BlockReader(const BlockReader&) = delete;
+    BlockReader& operator=(const BlockReader&) = delete;
+
+    // Next block in file order, empty when the file is over.
+    // The previous block goes back to the ring, views into it are invalidated.
+    std::string_view next();
+
+    bool exhausted() const {
+        return delivered_ >= fileSize_;
+    }
+
+    bool usesUring() const {
+        return uring_ != nullptr;
+    }
+
+private:
+    struct Buffer {
+        char* data = nullptr;
+        uint64_t offset = 0;
+        size_t len = 0;
+        // Holds a part of the file, being read or ready
+        bool inFlight = false;
+        // Request is in io_uring
+        bool queued = false;
+        bool ready = false;
+    };
+
+    void submit(size_t buffer);
+    void wait(size_t buffer);
+    void readFully(char* data, size_t len, uint64_t offset) const;
+
+    std::string path_;
+    int fd_ = -1;
+    uint64_t fileSize_ = 0;
+    size_t blockSize_;
+    std::unique_ptr<char, NodeFree> memory_;
+    std::vector<Buffer> buffers_;
+    // Buffer held by the consumer
+    size_t current_;
+    uint64_t submitOffset_ = 0;
+    uint64_t delivered_ = 0;
+    std::unique_ptr<Uring> uring_;
+};
+
+}   // namespace ozma
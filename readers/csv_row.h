@@ -0,0 +1,64 @@
+#pragma once
+
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+#include <string_view>
+
+namespace ozma {
+
+// Row of the "body",id,... layout
+struct CsvRow {
+    // Without outer quotes, inner quotes stay escaped as ""
+    std::string_view body;
+    int32_t id = 0;
+};
+
+// Closing quote of a quoted field, "" inside the field is an escaped quote
+inline const char* findQuotedEnd(const char* pos, const char* end) {
+    for (;;) {
+        pos = static_cast<const char*>(std::memchr(pos, '\"', end - pos));
+        if (pos == nullptr) {
+            return end;
+        }
+        if (pos + 1 < end && pos[1] == '\"') {
+            pos += 2;
+            continue;
+        }
+        return pos;
+    }
+}
+
+inline const char* nextRow(const char* pos, const char* end) {
+    const char* nl = static_cast<const char*>(std::memchr(pos, '\n', end - pos));
+    return nl ? nl + 1 : end;
+}
+
+// End of the row starting at pos (past its '\n'), nullptr if the row continues past end
+inline const char* findRowEnd(const char* pos, const char* end) {
+    if (pos < end && *pos == '\"') {
+        pos = findQuotedEnd(pos + 1, end);
+    }
+    const char* nl = static_cast<const char*>(std::memchr(pos, '\n', end - pos));
+    return nl ? nl + 1 : nullptr;
+}
+
+// Splits the row starting at pos, returns the beginning of the next row.
+// A row without a quoted body (header or malformed) gives an empty row.
+inline const char* splitRow(const char* pos, const char* end, CsvRow& row) {
+    if (*pos != '\"') {
+        row = CsvRow{};
+        return nextRow(pos, end);
+    }
+    const char* bodyBeg = pos + 1;
+    const char* bodyEnd = findQuotedEnd(bodyBeg, end);
+    row.body = std::string_view(bodyBeg, bodyEnd - bodyBeg);
+    row.id = 0;
+    const char* idBeg = bodyEnd + 2;
+    if (idBeg < end) {
+        std::from_chars(idBeg, end, row.id);
+    }
+    return nextRow(bodyEnd, end);
+}
+
+}   // namespace ozma
@@ -0,0 +1,58 @@
+#include "mapped_file.h"
+
+#include "common.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ozma {
+
+MappedFile::MappedFile(const std::string& path, bool populate)
+    : path_(path)
+    , populate_(populate) {
+    fd_ = open(path_.c_str(), O_RDONLY);
+    REQUIRE(fd_ != -1, "Can't open " << path_);
+    struct stat st {};
+    REQUIRE(fstat(fd_, &st) == 0, "Can't stat " << path_);
+    map(static_cast<size_t>(st.st_size));
+}
+
+MappedFile::~MappedFile() {
+    unmap();
+    close(fd_);
+}
+
+bool MappedFile::remap() {
+    struct stat st {};
+    REQUIRE(fstat(fd_, &st) == 0, "Can't stat " << path_);
+    const auto size = static_cast<size_t>(st.st_size);
+    if (size == size_) {
+        return false;
+    }
+    unmap();
+    map(size);
+    return true;
+}
+
+void MappedFile::map(size_t size) {
+    size_ = size;
+    if (size_ == 0) {
+        return;
+    }
+    const int flags = populate_ ? MAP_PRIVATE | MAP_POPULATE : MAP_PRIVATE;
+    void* addr = mmap(nullptr, size_, PROT_READ, flags, fd_, 0);
+    REQUIRE(addr != MAP_FAILED, "Can't mmap " << path_);
+    madvise(addr, size_, MADV_SEQUENTIAL);
+    data_ = static_cast<const char*>(addr);
+}
+
+void MappedFile::unmap() {
+    if (data_) {
+        munmap(const_cast<char*>(data_), size_);
+        data_ = nullptr;
+    }
+}
+
+}   // namespace ozma
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+namespace ozma {
+
+// Read-only mapping of the whole file
+class MappedFile {
+public:
+    // populate: prefault the whole file, otherwise pages are read on first access
+    explicit MappedFile(const std::string& path, bool populate = false);
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // Maps the file again if it has grown, returns true if the size changed.
+    // Pointers into the previous mapping are invalidated.
+    bool remap();
+
+    const char* data() const {
+        return data_;
+    }
+
+    size_t size() const {
+        return size_;
+    }
+
+    const char* end() const {
+        return data_ + size_;
+    }
+
+    const std::string& path() const {
+        return path_;
+    }
+
+private:
+    void map(size_t size);
+    void unmap();
+
+    std::string path_;
+    bool populate_;
+    int fd_ = -1;
+    const char* data_ = nullptr;
+    size_t size_ = 0;
+};
+
+}   // namespace ozma
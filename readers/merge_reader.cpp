@@ -0,0 +1,141 @@
+#include "merge_reader.h"
+#include "reader.h"
+
+#include "topology.h"
+#include "trace.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <utility>
+#include <immintrin.h>
+
+namespace ozma {
+
+MergeReader::MergeReader(
+    const std::vector<std::string>& paths,
+    size_t queueCapacity,
+    const std::vector<int>& cpus,
+    int node) {
+    REQUIRE(!paths.empty(), "Nothing to merge");
+    REQUIRE(
+        cpus.empty() || cpus.size() >= paths.size(),
+        "One cpu per merged file is needed, " << cpus.size() << " for " << paths.size());
+    for (size_t i = 0; i < paths.size(); i++) {
+        sources_.push_back(std::make_unique<Source>(queueCapacity, node));
+    }
+    for (size_t i = 0; i < paths.size(); i++) {
+        sources_[i]->thread = std::thread(
+            &MergeReader::produce, this, i, paths[i], cpus.empty() ? -1 : cpus[i]);
+    }
+}
+
+MergeReader::~MergeReader() {
+    stop_ = true;
+    for (auto& source : sources_) {
+        source->thread.join();
+    }
+}
+
+void MergeReader::produce(size_t index, const std::string& path, int cpu) {
+    if (cpu >= 0) {
+        applyPlacement(Placement{ { cpu } }, "merge " + std::to_string(index));
+    }
+    Tracer::registerThread("merge " + std::to_string(index));
+    Source& source = *sources_[index];
+    try {
+        Reader<Mmap> reader(path);
+        CustomAvxParser parser;
+        while (reader.valid() && !stop_) {
+            const uint64_t readBegin = Tracer::now();
+            auto data = reader.readLine();
+            if (!data) {
+                continue;
+            }
+            TraceRecord* trace = Tracer::begin(reader.row(), readBegin);
+            Tracer::mark(trace, TraceStage::Read);
+            BTCUSDT* slot = source.queue.back();
+            for (; slot == nullptr && !stop_; slot = source.queue.back()) {
+                _mm_pause();
+            }
+            if (slot == nullptr) {
+                break;
+            }
+            // the consumer lagging is not parse time
+            Tracer::mark(trace, TraceStage::Wait);
+            parser.parseEscaped(*data, *slot);
+            Tracer::mark(trace, TraceStage::Parse);
+            source.queue.push();
+        }
+    } catch (std::exception& ex) {
+        source.error = std::make_exception_ptr(
+            std::runtime_error("Merge input " + path + ": " + ex.what()));
+    }
+    source.done.store(true, std::memory_order_release);
+}
+
+bool MergeReader::waitFront(size_t index) {
+    Source& source = *sources_[index];
+    for (;;) {
+        if (source.queue.front() != nullptr) {
+            return true;
+        }
+        if (source.done.load(std::memory_order_acquire)) {
+            // pushes before done are visible now
+            if (source.queue.front() != nullptr) {
+                return true;
+            }
+            if (source.error) {
+                // the rest of the file would be missing from the merge. Thrown once, the source
+                // counts as exhausted afterwards.
+                std::rethrow_exception(std::exchange(source.error, nullptr));
+            }
+            return false;
+        }
+        _mm_pause();
+    }
+}
+
+bool MergeReader::later(size_t lhs, size_t rhs) {
+    const BTCUSDT& l = *sources_[lhs]->queue.front();
+    const BTCUSDT& r = *sources_[rhs]->queue.front();
+    return l.t != r.t ? l.t > r.t : l.u > r.u;
+}
+
+const BTCUSDT* MergeReader::next() {
+    auto later = [this](size_t lhs, size_t rhs) { return this->later(lhs, rhs); };
+    if (!started_) {
+        // after a source failed here, the next call starts over without it
+        heap_.clear();
+        for (size_t i = 0; i < sources_.size(); i++) {
+            if (waitFront(i)) {
+                heap_.push_back(i);
+            }
+        }
+        std::make_heap(heap_.begin(), heap_.end(), later);
+        started_ = true;
+    } else if (!heap_.empty()) {
+        // the update returned last goes back to its producer
+        std::pop_heap(heap_.begin(), heap_.end(), later);
+        sources_[current_]->queue.pop();
+        bool more = false;
+        try {
+            more = waitFront(current_);
+        } catch (...) {
+            // the heap stays valid without the failed source
+            heap_.pop_back();
+            throw;
+        }
+        if (more) {
+            std::push_heap(heap_.begin(), heap_.end(), later);
+        } else {
+            heap_.pop_back();
+        }
+    }
+    if (heap_.empty()) {
+        return nullptr;
+    }
+    current_ = heap_.front();
+    return sources_[current_]->queue.front();
+}
+
+}   // namespace ozma
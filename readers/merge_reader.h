@@ -0,0 +1,82 @@
+#pragma once
+
+#include "parser.h"
+#include "spsc_queue.h"
+#include "topology.h"
+
+#include <atomic>
+#include <cstddef>
+#include <exception>
+#include <memory>
+#include <memory_resource>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace ozma {
+
+// One stream of parsed updates ordered by (T, u) out of several csv files. Every file is read
+// (Reader<Mmap>) and parsed by its own thread into a bounded SPSC queue, the caller's thread
+// merges the queue heads. Each file has to be ordered by itself, as exchange dumps are.
+class MergeReader {
+public:
+    // cpus: one per file to pin the parsing threads to, empty: not pinned.
+    // node: numa node of the caller's thread for the queues and the levels in them,
+    // negative: not bound.
+    MergeReader(
+        const std::vector<std::string>& paths,
+        size_t queueCapacity = defaultQueueCapacity,
+        const std::vector<int>& cpus = {},
+        int node = -1);
+    ~MergeReader();
+
+    MergeReader(const MergeReader&) = delete;
+    MergeReader& operator=(const MergeReader&) = delete;
+
+    // Next update, nullptr when every file is exhausted. Valid until the next call.
+    // Rethrows the error of a file that failed, once its updates read before the error are out.
+    // The failed file is dropped: calling next() again goes on with the rest in order.
+    const BTCUSDT* next();
+
+    // File index of the update returned last
+    size_t source() const {
+        return current_;
+    }
+
+    constexpr static size_t defaultQueueCapacity = 1024;
+
+private:
+    struct Source {
+        Source(size_t capacity, int node)
+            : nodeMemory(node)
+            , levels(&nodeMemory)
+            , queue(capacity, node, BTCUSDT::allocator_type(&levels)) {
+        }
+
+        // Level buffers of the slots are on the merging thread's node as well. Only the
+        // producer allocates from the pool.
+        NodeResource nodeMemory;
+        std::pmr::unsynchronized_pool_resource levels;
+        SpscQueue<BTCUSDT> queue;
+        // Why the producer stopped early, written before done
+        std::exception_ptr error;
+        // Set by the producer after its last push
+        std::atomic<bool> done{ false };
+        std::thread thread;
+    };
+
+    void produce(size_t index, const std::string& path, int cpu);
+    // Waits for the next update of the source, false if the source is exhausted.
+    // Throws the error of the source producer once, exhausted afterwards.
+    bool waitFront(size_t index);
+    // Min-heap of sources on their front (T, u)
+    bool later(size_t lhs, size_t rhs);
+
+    std::vector<std::unique_ptr<Source>> sources_;
+    std::vector<size_t> heap_;
+    size_t current_ = 0;
+    bool started_ = false;
+    std::atomic<bool> stop_{ false };
+};
+
+}   // namespace ozma
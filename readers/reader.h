@@ -0,0 +1,317 @@
+#pragma once
+
+#include "block_reader.h"
+#include "common.h"
+#include "csv_row.h"
+#include "layout.h"
+#include "mapped_file.h"
+#include "parser.h"
+#include "sparse_index.h"
+
+#include "fastcsv/csv.h"
+
+#include "rapidcsv/src/rapidcsv.h"
+
+#include "vinces/single_include/csv.hpp"
+#include <optional>
+#include <string>
+#include <string_view>
+
+namespace ozma {
+
+using Fastcsv = io::CSVReader<4, io::trim_chars<' ', '\t'>, io::double_quote_escape<',', '\"'>>;
+using Rapidcsv = rapidcsv::Document;
+using Vinces = csv::CSVReader;
+// Own reader over the mapped file, gives the body field as is (still escaped)
+struct Mmap {};
+// Own reader over a BlockReader: bounded memory, for files larger than RAM
+struct Stream {};
+
+template <typename ReaderT>
+class Reader;
+
+template <>
+class Reader<Fastcsv> {
+public:
+    explicit Reader(const std::string& path)
+        : reader_(path) {
+    }
+
+    std::optional<std::string> readLine() { 
+        valid_ = reader_.read_row(body_, id_, b1_, b2_);
+        if (valid_ && (id_ == BTCUSDT::iD1 || id_ == BTCUSDT::iD2)) {
+            return std::optional<std::string>{std::move(body_)};
+        }
+        return std::nullopt;
+    }
+
+    bool valid() const {
+        return valid_;
+    }
+
+private:
+    Fastcsv reader_;
+    std::string body_;
+    int32_t id_, b1_, b2_;
+    bool valid_ = true;
+};
+
+template <>
+class Reader<Rapidcsv> {
+private:
+    const static inline size_t DATA_COL = 0;
+    const static inline size_t ID_COL = 1;
+
+public:
+    explicit Reader(const std::string& path)
+        : reader_(path)
+        , lines_(reader_.GetRowCount())
+        , line_(0) {
+    }
+
+    std::optional<std::string> readLine() {
+        const auto id = reader_.GetCell<int32_t>(ID_COL, line_);
+        if (id == BTCUSDT::iD1 || id == BTCUSDT::iD2) {
+            return reader_.GetCell<std::string>(DATA_COL, line_++);
+        }
+        line_++;
+        return std::nullopt;
+    }
+
+    bool valid() const {
+        return line_ < lines_;
+    }
+
+    void seek(const IndexEntry& entry) {
+        line_ = entry.row;
+    }
+
+    // Positions at the first BTCUSDT row with T >= t, as Reader<Mmap> does
+    void seekTime(const SparseIndex& index, int64_t t) {
+        seek(index.seekTime(t));
+        skipWhile([t](const Stamp& stamp) { return stamp.t < t; });
+    }
+
+    // Positions at the first BTCUSDT row with u >= u
+    void seekSeq(const SparseIndex& index, int64_t u) {
+        seek(index.seekSeq(u));
+        skipWhile([u](const Stamp& stamp) { return stamp.u < u; });
+    }
+
+private:
+    template <typename Pred>
+    void skipWhile(Pred pred) {
+        for (; valid(); line_++) {
+            const auto id = reader_.GetCell<int32_t>(ID_COL, line_);
+            // Cells come unescaped
+            if ((id == BTCUSDT::iD1 || id == BTCUSDT::iD2) &&
+                !pred(parseStamp<1>(reader_.GetCell<std::string>(DATA_COL, line_)))) {
+                return;
+            }
+        }
+    }
+
+    Rapidcsv reader_;
+    size_t lines_;
+    size_t line_;
+};
+
+template <>
+class Reader<Vinces> {
+private:
+    const static inline size_t DATA_COL = 0;
+    const static inline size_t ID_COL = 1;
+
+public:
+    explicit Reader(const std::string& path)
+        : reader_(path), cur_(reader_.begin()) {
+    }
+
+    std::optional<std::string> readLine() {
+        if ((*cur_)[ID_COL] == BTCUSDT::iD1 || (*cur_)[ID_COL] == BTCUSDT::iD2) {
+            return (*cur_++)[DATA_COL].get();
+        }
+        ++cur_;
+        return std::nullopt;
+    }
+
+    bool valid() const {
+        return cur_ != reader_.end();
+    }
+
+private:
+    Vinces reader_;
+    Vinces::iterator cur_;
+};
+
+template <>
+class Reader<Mmap> {
+public:
+    // populate: prefault the whole file, off when only a part of it is going to be read
+    explicit Reader(const std::string& path, bool populate = true)
+        : file_(path, populate)
+        , cur_(file_.data()) {
+    }
+
+    // Returns the body without outer quotes, inner quotes stay escaped as ""
+    std::optional<std::string_view> readLine() {
+        const char* rowBeg = cur_;
+        CsvRow row;
+        cur_ = splitRow(cur_, file_.end(), row);
+        if (*rowBeg != '\"') {
+            // header or malformed row
+            return std::nullopt;
+        }
+        row_++;
+        id_ = row.id;
+        if (row.id == BTCUSDT::iD1 || row.id == BTCUSDT::iD2) {
+            return row.body;
+        }
+        return std::nullopt;
+    }
+
+    // Id of the last row read
+    int32_t id() const {
+        return id_;
+    }
+
+    bool valid() const {
+        return cur_ < file_.end();
+    }
+
+    void seek(const IndexEntry& entry) {
+        cur_ = file_.data() + entry.offset;
+        row_ = entry.row;
+    }
+
+    // Positions at the first BTCUSDT row with T >= t
+    void seekTime(const SparseIndex& index, int64_t t) {
+        seek(index.seekTime(t));
+        skipWhile([t](const Stamp& stamp) { return stamp.t < t; });
+    }
+
+    // Positions at the first BTCUSDT row with u >= u
+    void seekSeq(const SparseIndex& index, int64_t u) {
+        seek(index.seekSeq(u));
+        skipWhile([u](const Stamp& stamp) { return stamp.u < u; });
+    }
+
+    // Number of rows read so far, header excluded
+    uint64_t row() const {
+        return row_;
+    }
+
+    // Byte offset of the next row, seek() takes it back
+    uint64_t offset() const {
+        return static_cast<uint64_t>(cur_ - file_.data());
+    }
+
+    const MappedFile& file() const {
+        return file_;
+    }
+
+private:
+    template <typename Pred>
+    void skipWhile(Pred pred) {
+        while (valid()) {
+            CsvRow row;
+            const char* next = splitRow(cur_, file_.end(), row);
+            if (*cur_ == '\"' && (row.id == BTCUSDT::iD1 || row.id == BTCUSDT::iD2) &&
+                !pred(parseStamp<2>(row.body))) {
+                return;
+            }
+            if (*cur_ == '\"') {
+                row_++;
+            }
+            cur_ = next;
+        }
+    }
+
+    MappedFile file_;
+    const char* cur_;
+    uint64_t row_ = 0;
+    int32_t id_ = 0;
+};
+
+template <>
+class Reader<Stream> {
+public:
+    // node: numa node of the reading thread for the block buffers, negative: not bound
+    explicit Reader(
+        const std::string& path,
+        size_t blockSize = BlockReader::defaultBlockSize,
+        size_t blocks = BlockReader::defaultBlocks,
+        int node = -1)
+        : blocks_(path, blockSize, blocks, true, node) {
+    }
+
+    // Same as Reader<Mmap>::readLine, the view is valid until the next call
+    std::optional<std::string_view> readLine() {
+        if (pos_ == end_ && !fetch()) {
+            return std::nullopt;
+        }
+        const char* rowBeg = pos_;
+        const char* rowEnd = findRowEnd(pos_, end_);
+        if (rowEnd != nullptr) {
+            pos_ = rowEnd;
+        } else {
+            rowEnd = joinStraddling();
+            rowBeg = carry_.data();
+        }
+        if (*rowBeg != '\"') {
+            return std::nullopt;
+        }
+        CsvRow row;
+        splitRow(rowBeg, rowEnd, row);
+        id_ = row.id;
+        if (row.id == BTCUSDT::iD1 || row.id == BTCUSDT::iD2) {
+            return row.body;
+        }
+        return std::nullopt;
+    }
+
+    // Id of the last row read
+    int32_t id() const {
+        return id_;
+    }
+
+    bool valid() const {
+        return pos_ < end_ || !blocks_.exhausted();
+    }
+
+    const BlockReader& blocks() const {
+        return blocks_;
+    }
+
+private:
+    bool fetch() {
+        const auto block = blocks_.next();
+        pos_ = block.data();
+        end_ = block.data() + block.size();
+        return !block.empty();
+    }
+
+    // Row that doesn't end in the current block: copies its parts into carry_
+    const char* joinStraddling() {
+        carry_.assign(pos_, end_);
+        pos_ = end_;
+        while (fetch()) {
+            const char* nl = static_cast<const char*>(std::memchr(pos_, '\n', end_ - pos_));
+            const char* stop = nl ? nl + 1 : end_;
+            carry_.append(pos_, stop);
+            pos_ = stop;
+            if (nl && findRowEnd(carry_.data(), carry_.data() + carry_.size())) {
+                break;
+            }
+        }
+        return carry_.data() + carry_.size();
+    }
+
+    BlockReader blocks_;
+    const char* pos_ = nullptr;
+    const char* end_ = nullptr;
+    std::string carry_;
+    int32_t id_ = 0;
+};
+
+}   // namespace ozma
@@ -0,0 +1,166 @@
+#include "sparse_index.h"
+
+#include "common.h"
+#include "csv_row.h"
+#include "layout.h"
+#include "parser.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace ozma {
+
+namespace {
+
+const char INDEX_MAGIC[8] = { 'C', 'S', 'V', 'I', 'D', 'X', '0', '1' };
+
+bool isBTCUSDT(const CsvRow& row) {
+    return (row.id == BTCUSDT::iD1 || row.id == BTCUSDT::iD2) &&
+           row.body.size() > Layout<2>::uBeg + Layout<2>::len;
+}
+
+}   // namespace
+
+SparseIndex::SparseIndex(const std::string& path, size_t step)
+    : path_(path)
+    , step_(step) {
+    REQUIRE(step_ > 0, "Index step must be positive");
+}
+
+SparseIndex SparseIndex::load(const MappedFile& file, size_t step) {
+    SparseIndex index(pathFor(file.path()), step);
+    if (!index.read() || !index.matches(file)) {
+        index = SparseIndex(pathFor(file.path()), step);
+    }
+    index.update(file);
+    return index;
+}
+
+bool SparseIndex::read() {
+    std::ifstream in(path_, std::ios::binary);
+    if (!in) {
+        return false;
+    }
+    Header header{};
+    if (!in.read(reinterpret_cast<char*>(&header), sizeof(header)) ||
+        std::memcmp(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC)) != 0 || header.step != step_) {
+        return false;
+    }
+    entries_.resize(header.entries);
+    if (!in.read(
+            reinterpret_cast<char*>(entries_.data()),
+            static_cast<std::streamsize>(entries_.size() * sizeof(IndexEntry)))) {
+        entries_.clear();
+        return false;
+    }
+    indexedBytes_ = header.indexedBytes;
+    indexedRows_ = header.indexedRows;
+    nextEntryRow_ = header.nextEntryRow;
+    return true;
+}
+
+// The csv may only have grown since the index was written: indexed part ends at a row boundary
+// and the last entry still points to the same message
+bool SparseIndex::matches(const MappedFile& file) const {
+    if (file.size() < indexedBytes_) {
+        return false;
+    }
+    if (indexedBytes_ > 0 && file.data()[indexedBytes_ - 1] != '\n') {
+        return false;
+    }
+    if (entries_.empty()) {
+        return true;
+    }
+    const IndexEntry& last = entries_.back();
+    if (last.offset >= indexedBytes_) {
+        return false;
+    }
+    CsvRow row;
+    splitRow(file.data() + last.offset, file.end(), row);
+    if (!isBTCUSDT(row)) {
+        return false;
+    }
+    const auto stamp = parseStamp<2>(row.body);
+    return stamp.t == last.t && stamp.u == last.u;
+}
+
+size_t SparseIndex::update(const MappedFile& file) {
+    const char* pos = file.data() + indexedBytes_;
+    // Only complete rows, the last one may be still being written
+    const char* lastNl =
+        static_cast<const char*>(memrchr(pos, '\n', file.size() - indexedBytes_));
+    if (lastNl == nullptr) {
+        return 0;
+    }
+    const char* end = lastNl + 1;
+
+    const size_t entriesBefore = entries_.size();
+    while (pos < end) {
+        const char* rowBeg = pos;
+        CsvRow row;
+        pos = splitRow(pos, end, row);
+        if (*rowBeg != '\"') {
+            // header is not a row
+            continue;
+        }
+        if (indexedRows_ >= nextEntryRow_ && isBTCUSDT(row)) {
+            const auto stamp = parseStamp<2>(row.body);
+            entries_.push_back(IndexEntry{
+                static_cast<uint64_t>(rowBeg - file.data()), indexedRows_, stamp.t, stamp.u });
+            nextEntryRow_ = indexedRows_ + step_;
+        }
+        indexedRows_++;
+    }
+    indexedBytes_ = static_cast<uint64_t>(end - file.data());
+    return entries_.size() - entriesBefore;
+}
+
+void SparseIndex::save() const {
+    Header header{};
+    std::memcpy(header.magic, INDEX_MAGIC, sizeof(INDEX_MAGIC));
+    header.step = step_;
+    header.indexedBytes = indexedBytes_;
+    header.indexedRows = indexedRows_;
+    header.nextEntryRow = nextEntryRow_;
+    header.entries = entries_.size();
+
+    // Readers never see a half-written index
+    const std::string tmpPath = path_ + ".tmp";
+    {
+        std::ofstream out(tmpPath, std::ios::binary | std::ios::trunc);
+        REQUIRE(out.is_open(), "Can't write " << tmpPath);
+        out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+        out.write(
+            reinterpret_cast<const char*>(entries_.data()),
+            static_cast<std::streamsize>(entries_.size() * sizeof(IndexEntry)));
+        REQUIRE(out.good(), "Can't write " << tmpPath);
+    }
+    REQUIRE(std::rename(tmpPath.c_str(), path_.c_str()) == 0, "Can't replace " << path_);
+}
+
+IndexEntry SparseIndex::seekTime(int64_t t) const {
+    // Many rows share a millisecond: an entry with T == t may have rows with the same T before it
+    auto it = std::lower_bound(
+        entries_.begin(), entries_.end(), t, [](const IndexEntry& entry, int64_t value) {
+            return entry.t < value;
+        });
+    if (it == entries_.begin()) {
+        return IndexEntry{};
+    }
+    return *std::prev(it);
+}
+
+IndexEntry SparseIndex::seekSeq(int64_t u) const {
+    auto it = std::lower_bound(
+        entries_.begin(), entries_.end(), u, [](const IndexEntry& entry, int64_t value) {
+            return entry.u < value;
+        });
+    if (it == entries_.begin()) {
+        return IndexEntry{};
+    }
+    return *std::prev(it);
+}
+
+}   // namespace ozma
@@ -0,0 +1,74 @@
+#pragma once
+
+#include "mapped_file.h"
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace ozma {
+
+struct IndexEntry {
+    // Beginning of the row in the csv
+    uint64_t offset{};
+    uint64_t row{};
+    int64_t t{};
+    int64_t u{};
+};
+
+// Sidecar index <csv>.idx with an entry per ~step rows (at the first BTCUSDT row of each step).
+// Rows appended to the csv after the last update are indexed incrementally.
+class SparseIndex {
+public:
+    constexpr static size_t defaultStep = 4096;
+
+    // Loads the index of the file and brings it up to date.
+    // Builds it from scratch if it is missing, built with another step or doesn't match the csv.
+    static SparseIndex load(const MappedFile& file, size_t step = defaultStep);
+
+    static std::string pathFor(const std::string& csvPath) {
+        return csvPath + ".idx";
+    }
+
+    // Indexes complete rows appended since the last update, returns the number of new entries
+    size_t update(const MappedFile& file);
+    void save() const;
+
+    // Last entry with T < t, the beginning of the file if there is none.
+    // The caller skips forward to the first row with T >= t.
+    IndexEntry seekTime(int64_t t) const;
+    // Last entry with u < u, the beginning of the file if there is none
+    IndexEntry seekSeq(int64_t u) const;
+
+    const std::vector<IndexEntry>& entries() const {
+        return entries_;
+    }
+
+    uint64_t indexedRows() const {
+        return indexedRows_;
+    }
+
+private:
+    struct Header {
+        char magic[8];
+        uint64_t step;
+        uint64_t indexedBytes;
+        uint64_t indexedRows;
+        uint64_t nextEntryRow;
+        uint64_t entries;
+    };
+
+    SparseIndex(const std::string& path, size_t step);
+
+    bool read();
+    bool matches(const MappedFile& file) const;
+
+    std::string path_;
+    size_t step_;
+    uint64_t indexedBytes_ = 0;
+    uint64_t indexedRows_ = 0;
+    uint64_t nextEntryRow_ = 0;
+    std::vector<IndexEntry> entries_;
+};
+
+}   // namespace ozma
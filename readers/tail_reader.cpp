@@ -0,0 +1,177 @@
+#include "tail_reader.h"
+
+#include "csv_row.h"
+#include "parser.h"
+
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/inotify.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+namespace ozma {
+
+namespace {
+
+const size_t INITIAL_BUFFER = 1 << 20;
+
+int connectUnix(const std::string& path) {
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    REQUIRE(fd != -1, "Can't create socket: " << std::strerror(errno));
+    sockaddr_un addr{};
+    addr.sun_family = AF_UNIX;
+    REQUIRE(path.size() < sizeof(addr.sun_path), "Socket path is too long: " << path);
+    std::memcpy(addr.sun_path, path.c_str(), path.size() + 1);
+    REQUIRE(
+        connect(fd, reinterpret_cast<sockaddr*>(&addr), sizeof(addr)) == 0,
+        "Can't connect to " << path << ": " << std::strerror(errno));
+    return fd;
+}
+
+}   // namespace
+
+TailReader::TailReader(Source source, const std::string& path, bool fromStart, int stopFd)
+    : source_(source)
+    , stopFd_(stopFd)
+    , buf_(INITIAL_BUFFER) {
+    switch (source_) {
+    case Source::File:
+        // Watch first: an append between the last read and the wait still wakes us up
+        inotifyFd_ = inotify_init1(IN_CLOEXEC);
+        REQUIRE(inotifyFd_ != -1, "inotify_init1 error: " << std::strerror(errno));
+        REQUIRE(
+            inotify_add_watch(
+                inotifyFd_,
+                path.c_str(),
+                IN_MODIFY | IN_ATTRIB | IN_DELETE_SELF | IN_MOVE_SELF) != -1,
+            "Can't watch " << path << ": " << std::strerror(errno));
+        fd_ = open(path.c_str(), O_RDONLY);
+        REQUIRE(fd_ != -1, "Can't open " << path);
+        if (!fromStart) {
+            lseek(fd_, 0, SEEK_END);
+        }
+        break;
+    case Source::Stdin:
+        fd_ = STDIN_FILENO;
+        break;
+    case Source::Socket:
+        fd_ = connectUnix(path);
+        break;
+    }
+}
+
+TailReader::~TailReader() {
+    if (source_ != Source::Stdin) {
+        close(fd_);
+    }
+    if (inotifyFd_ != -1) {
+        close(inotifyFd_);
+    }
+}
+
+std::optional<std::string_view> TailReader::readLine() {
+    for (;;) {
+        const char* rowBeg = buf_.data() + head_;
+        const char* rowEnd = findRowEnd(rowBeg, buf_.data() + tail_);
+        if (rowEnd == nullptr) {
+            if (!fill()) {
+                closed_ = true;
+                return std::nullopt;
+            }
+            continue;
+        }
+        head_ = rowEnd - buf_.data();
+        // Rows are consumed before reading more, so the last read completed this one
+        arrival_ = lastRead_;
+        if (*rowBeg != '\"') {
+            return std::nullopt;
+        }
+        CsvRow row;
+        splitRow(rowBeg, rowEnd, row);
+        id_ = row.id;
+        if (row.id == BTCUSDT::iD1 || row.id == BTCUSDT::iD2) {
+            return row.body;
+        }
+        return std::nullopt;
+    }
+}
+
+bool TailReader::fill() {
+    if (head_ > 0) {
+        std::memmove(buf_.data(), buf_.data() + head_, tail_ - head_);
+        tail_ -= head_;
+        head_ = 0;
+    }
+    if (tail_ == buf_.size()) {
+        buf_.resize(buf_.size() * 2);
+    }
+    for (;;) {
+        if (!waitReadable(fd_)) {
+            return false;
+        }
+        const ssize_t res = read(fd_, buf_.data() + tail_, buf_.size() - tail_);
+        if (res > 0) {
+            lastRead_ = TimePoint::clock::now();
+            tail_ += static_cast<size_t>(res);
+            return true;
+        }
+        if (res < 0) {
+            REQUIRE(errno == EINTR, "Read error: " << std::strerror(errno));
+            continue;
+        }
+        if (source_ != Source::File || !waitGrowth()) {
+            return false;
+        }
+    }
+}
+
+// Blocks until the followed file is modified, false if it is gone or the reader is stopped
+bool TailReader::waitGrowth() {
+    alignas(inotify_event) char events[4096];
+    for (;;) {
+        if (!waitReadable(inotifyFd_)) {
+            return false;
+        }
+        const ssize_t len = read(inotifyFd_, events, sizeof(events));
+        if (len < 0) {
+            REQUIRE(errno == EINTR, "inotify read error: " << std::strerror(errno));
+            continue;
+        }
+        bool modified = false;
+        for (ssize_t i = 0; i < len;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(events + i);
+            if (event->mask & (IN_DELETE_SELF | IN_MOVE_SELF | IN_IGNORED)) {
+                return false;
+            }
+            // Unlinked while we keep it open: IN_DELETE_SELF comes only after close
+            struct stat st {};
+            if ((event->mask & IN_ATTRIB) && fstat(fd_, &st) == 0 && st.st_nlink == 0) {
+                return false;
+            }
+            modified |= (event->mask & IN_MODIFY) != 0;
+            i += static_cast<ssize_t>(sizeof(inotify_event) + event->len);
+        }
+        if (modified) {
+            return true;
+        }
+    }
+}
+
+bool TailReader::waitReadable(int fd) const {
+    // Negative fds are ignored by poll
+    pollfd fds[2] = { { fd, POLLIN, 0 }, { stopFd_, POLLIN, 0 } };
+    for (;;) {
+        if (poll(fds, 2, -1) < 0) {
+            REQUIRE(errno == EINTR, "poll error: " << std::strerror(errno));
+            continue;
+        }
+        // Stop wins over pending data
+        return fds[1].revents == 0;
+    }
+}
+
+}   // namespace ozma
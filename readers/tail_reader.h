@@ -0,0 +1,65 @@
+#pragma once
+
+#include "common.h"
+
+#include <optional>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ozma {
+
+// Rows of a live source: a csv file that keeps growing (followed with inotify, no polling),
+// stdin or a local unix socket. readLine() blocks until a complete row arrives.
+class TailReader {
+public:
+    enum class Source { File, Stdin, Socket };
+
+    // File: path of the csv, starts from its current end unless fromStart.
+    // Socket: path of a unix stream socket served by the feed.
+    // stopFd: becomes readable when the reader has to stop (e.g. an eventfd written by a signal
+    // handler), polled together with the source so a stop is never missed while blocked
+    TailReader(Source source, const std::string& path = {}, bool fromStart = false, int stopFd = -1);
+    ~TailReader();
+
+    TailReader(const TailReader&) = delete;
+    TailReader& operator=(const TailReader&) = delete;
+
+    // Same as Reader<Mmap>::readLine, the view is valid until the next call.
+    // nullopt with valid() == false when the source is closed or stopped.
+    std::optional<std::string_view> readLine();
+
+    bool valid() const {
+        return !closed_;
+    }
+
+    // Id of the last row read
+    int32_t id() const {
+        return id_;
+    }
+
+    // When the bytes completing the last row were read
+    TimePoint arrival() const {
+        return arrival_;
+    }
+
+private:
+    bool fill();
+    bool waitGrowth();
+    // Blocks until fd is readable, false if stopped first
+    bool waitReadable(int fd) const;
+
+    Source source_;
+    int fd_ = -1;
+    int inotifyFd_ = -1;
+    int stopFd_;
+    std::vector<char> buf_;
+    size_t head_ = 0;
+    size_t tail_ = 0;
+    TimePoint lastRead_{};
+    TimePoint arrival_{};
+    int32_t id_ = 0;
+    bool closed_ = false;
+};
+
+}   // namespace ozma
@@ -0,0 +1,147 @@
+#include "shm_ring.h"
+
+#include "common.h"
+#include "logger.h"
+#include "topology.h"
+
+#include <bit>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <immintrin.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace ozma {
+
+namespace {
+
+size_t segmentSize(uint64_t capacity) {
+    return sizeof(shm::Header) + capacity * sizeof(shm::Slot);
+}
+
+}   // namespace
+
+ShmRingPublisher::ShmRingPublisher(const std::string& name, size_t capacity, int node)
+    : name_(name) {
+    const uint64_t slots = std::bit_ceil(std::max<uint64_t>(capacity, 2));
+    mapSize_ = segmentSize(slots);
+
+    shm_unlink(name_.c_str());
+    const int fd = shm_open(name_.c_str(), O_CREAT | O_EXCL | O_RDWR, 0644);
+    REQUIRE(fd != -1, "Can't create shm " << name_ << ": " << std::strerror(errno));
+    REQUIRE(
+        ftruncate(fd, static_cast<off_t>(mapSize_)) == 0,
+        "Can't size shm " << name_ << ": " << std::strerror(errno));
+    void* addr = mmap(nullptr, mapSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd);
+    REQUIRE(addr != MAP_FAILED, "Can't map shm " << name_ << ": " << std::strerror(errno));
+    if (!bindToNode(addr, mapSize_, node)) {
+        WARN() << "Can't bind shm " << name_ << " to numa node " << node;
+    }
+
+    // Fresh segment is zero-filled: all slots have seq 0, nothing published
+    header_ = static_cast<shm::Header*>(addr);
+    slots_ = reinterpret_cast<shm::Slot*>(static_cast<char*>(addr) + sizeof(shm::Header));
+    mask_ = slots - 1;
+    header_->version = shm::VERSION;
+    header_->slotSize = sizeof(shm::Slot);
+    header_->capacity = slots;
+    // Consumers check the magic last
+    std::atomic_ref<uint64_t>(header_->magic).store(shm::MAGIC, std::memory_order_release);
+}
+
+ShmRingPublisher::~ShmRingPublisher() {
+    munmap(header_, mapSize_);
+    shm_unlink(name_.c_str());
+}
+
+ShmUpdate& ShmRingPublisher::beginWrite() {
+    shm::Slot& slot = slots_[next_ & mask_];
+    slot.seq.store(2 * next_ + 1, std::memory_order_relaxed);
+    // Payload stores must not become visible before the odd seq
+    std::atomic_thread_fence(std::memory_order_release);
+    return slot.update;
+}
+
+void ShmRingPublisher::commit() {
+    shm::Slot& slot = slots_[next_ & mask_];
+    slot.seq.store(2 * next_ + 2, std::memory_order_release);
+    next_++;
+    header_->published.store(next_, std::memory_order_release);
+}
+
+ShmRingConsumer::ShmRingConsumer(const std::string& name) {
+    const int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    REQUIRE(fd != -1, "Can't open shm " << name << ": " << std::strerror(errno));
+    struct stat st {};
+    REQUIRE(fstat(fd, &st) == 0, "Can't stat shm " << name);
+    mapSize_ = static_cast<size_t>(st.st_size);
+    REQUIRE(mapSize_ >= sizeof(shm::Header), "Shm " << name << " is too small");
+    void* addr = mmap(nullptr, mapSize_, PROT_READ, MAP_SHARED | MAP_POPULATE, fd, 0);
+    close(fd);
+    REQUIRE(addr != MAP_FAILED, "Can't map shm " << name << ": " << std::strerror(errno));
+
+    header_ = static_cast<const shm::Header*>(addr);
+    REQUIRE(
+        std::atomic_ref<const uint64_t>(header_->magic).load(std::memory_order_acquire) ==
+                shm::MAGIC &&
+            header_->version == shm::VERSION && header_->slotSize == sizeof(shm::Slot) &&
+            mapSize_ >= segmentSize(header_->capacity),
+        "Shm " << name << " is not a compatible ring");
+    slots_ = reinterpret_cast<const shm::Slot*>(
+        static_cast<const char*>(addr) + sizeof(shm::Header));
+    mask_ = header_->capacity - 1;
+    next_ = header_->published.load(std::memory_order_acquire);
+}
+
+ShmRingConsumer::~ShmRingConsumer() {
+    munmap(const_cast<shm::Header*>(header_), mapSize_);
+}
+
+ShmRingConsumer::Status ShmRingConsumer::poll(ShmUpdate& out) {
+    Status status = Status::Ok;
+    uint32_t spins = 0;
+    for (;;) {
+        const shm::Slot& slot = slots_[next_ & mask_];
+        const uint64_t expected = 2 * next_ + 2;
+        const uint64_t before = slot.seq.load(std::memory_order_acquire);
+        if (before < expected) {
+            // Being written right now. A publisher that died mid-write never finishes it:
+            // give up after a while, the next poll looks again.
+            if (before + 1 == expected && ++spins < writeSpins) {
+                _mm_pause();
+                continue;
+            }
+            return status == Status::Ok ? Status::Empty : status;
+        }
+        if (before > expected) {
+            // overwritten: jump to the oldest update still in the ring
+            const uint64_t published = header_->published.load(std::memory_order_acquire);
+            const uint64_t oldest = published > mask_ + 1 ? published - (mask_ + 1) : 0;
+            const uint64_t resume = std::max(oldest + 1, next_ + 1);
+            lost_ += resume - next_;
+            next_ = resume;
+            status = Status::Lost;
+            continue;
+        }
+
+        out.t = slot.update.t;
+        out.u = slot.update.u;
+        out.asks = std::min<uint32_t>(slot.update.asks, ShmUpdate::maxLevels);
+        out.bids = std::min<uint32_t>(slot.update.bids, ShmUpdate::maxLevels);
+        out.truncated = slot.update.truncated;
+        std::memcpy(out.levels, slot.update.levels, (out.asks + out.bids) * sizeof(ShmLevel));
+
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (slot.seq.load(std::memory_order_relaxed) != before) {
+            // overwritten while copying
+            continue;
+        }
+        next_++;
+        return status;
+    }
+}
+
+}   // namespace ozma
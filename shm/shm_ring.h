@@ -0,0 +1,151 @@
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <span>
+#include <string>
+
+namespace ozma {
+
+// Single-producer multi-consumer ring of parsed order book updates in POSIX shared memory.
+// Slots are fixed-size records with levels inline, guarded by a per-slot seqlock:
+// the publisher never waits for consumers, a consumer that falls behind by more than
+// the ring capacity loses the overwritten updates and is told so.
+// Neither side makes syscalls after attaching.
+
+struct ShmLevel {
+    float price{};
+    float size{};
+};
+
+struct ShmUpdate {
+    // Levels per side, the rest of a larger message is dropped and truncated is set
+    constexpr static size_t maxLevels = 64;
+
+    int64_t t{};
+    int64_t u{};
+    uint32_t asks{};
+    uint32_t bids{};
+    uint32_t truncated{};
+    // Asks first, then bids
+    ShmLevel levels[maxLevels * 2];
+
+    std::span<const ShmLevel> askLevels() const {
+        return { levels, asks };
+    }
+
+    std::span<const ShmLevel> bidLevels() const {
+        return { levels + asks, bids };
+    }
+};
+
+namespace shm {
+
+constexpr uint64_t MAGIC = 0x4f5a4d4152494e47;   // OZMARING
+constexpr uint32_t VERSION = 1;
+
+struct alignas(64) Slot {
+    // 2n + 1 while update n is being written, 2n + 2 when it is complete
+    std::atomic<uint64_t> seq;
+    ShmUpdate update;
+};
+
+struct alignas(64) Header {
+    uint64_t magic;
+    uint32_t version;
+    uint32_t slotSize;
+    uint64_t capacity;
+    // Number of updates published so far, on its own cache line
+    alignas(64) std::atomic<uint64_t> published;
+};
+
+}   // namespace shm
+
+class ShmRingPublisher {
+public:
+    // Creates (or recreates) the segment, capacity is rounded up to a power of two.
+    // node: numa node the consumers run on, negative: not bound.
+    ShmRingPublisher(const std::string& name, size_t capacity, int node = -1);
+    ~ShmRingPublisher();
+
+    ShmRingPublisher(const ShmRingPublisher&) = delete;
+    ShmRingPublisher& operator=(const ShmRingPublisher&) = delete;
+
+    // Levels: any range of objects with price and size
+    template <typename Levels>
+    void publish(int64_t t, int64_t u, const Levels& asks, const Levels& bids) {
+        ShmUpdate& update = beginWrite();
+        update.t = t;
+        update.u = u;
+        update.asks = fill(update.levels, asks);
+        update.bids = fill(update.levels + update.asks, bids);
+        update.truncated = update.asks < asks.size() || update.bids < bids.size();
+        commit();
+    }
+
+    uint64_t published() const {
+        return next_;
+    }
+
+private:
+    template <typename Levels>
+    static uint32_t fill(ShmLevel* out, const Levels& levels) {
+        uint32_t n = 0;
+        for (const auto& level : levels) {
+            if (n == ShmUpdate::maxLevels) {
+                break;
+            }
+            out[n++] = ShmLevel{ level.price, level.size };
+        }
+        return n;
+    }
+
+    ShmUpdate& beginWrite();
+    void commit();
+
+    std::string name_;
+    size_t mapSize_ = 0;
+    shm::Header* header_ = nullptr;
+    shm::Slot* slots_ = nullptr;
+    uint64_t mask_ = 0;
+    uint64_t next_ = 0;
+};
+
+class ShmRingConsumer {
+public:
+    enum class Status {
+        Ok,
+        // Nothing new
+        Empty,
+        // Fell behind: updates were overwritten, continues from the oldest available one
+        Lost
+    };
+
+    // Attaches to an existing segment and starts from the next update to be published
+    explicit ShmRingConsumer(const std::string& name);
+    ~ShmRingConsumer();
+
+    ShmRingConsumer(const ShmRingConsumer&) = delete;
+    ShmRingConsumer& operator=(const ShmRingConsumer&) = delete;
+
+    // Copies the next update into out on Ok. Waits at most writeSpins pauses for an update
+    // that is being written, Empty after that.
+    Status poll(ShmUpdate& out);
+
+    constexpr static uint32_t writeSpins = 1 << 12;
+
+    uint64_t lost() const {
+        return lost_;
+    }
+
+private:
+    size_t mapSize_ = 0;
+    const shm::Header* header_ = nullptr;
+    const shm::Slot* slots_ = nullptr;
+    uint64_t mask_ = 0;
+    uint64_t next_ = 0;
+    uint64_t lost_ = 0;
+};
+
+}   // namespace ozma
@@ -0,0 +1,91 @@
+#pragma once
+
+#include "topology.h"
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <memory_resource>
+
+namespace ozma {
+
+// Monotonic arena: allocation is a pointer bump, deallocation is a no-op,
+// reset() drops everything at once and starts again from the preallocated buffer.
+// Goes to the heap only when the buffer is exhausted.
+class Arena {
+public:
+    // node: numa node of the thread reading the allocations, negative: not bound
+    explicit Arena(size_t capacity, int node = -1)
+        : buffer_(static_cast<std::byte*>(allocOnNode(capacity, node)), NodeFree{ capacity })
+        , resource_(buffer_.get(), capacity)
+        , used_(resource_, buffer_.get(), capacity) {
+    }
+
+    Arena(const Arena&) = delete;
+    Arena& operator=(const Arena&) = delete;
+
+    std::pmr::memory_resource* resource() {
+        return &used_;
+    }
+
+    void reset() {
+        resource_.release();
+        used_.bytes = 0;
+    }
+
+    // Bytes of the preallocated buffer handed out so far
+    size_t used() const {
+        return used_.bytes;
+    }
+
+    // The part of the preallocated buffer handed out since used() was from, for CachePressure.
+    // Overflow allocations are not reported.
+    template <typename Visit>
+    void visitBuffers(Visit&& visit, size_t from = 0) const {
+        if (used_.bytes > from) {
+            visit(buffer_.get() + from, used_.bytes - from);
+        }
+    }
+
+private:
+    // Forwards to the arena, remembers how far into the buffer allocations went
+    class UsedBytes : public std::pmr::memory_resource {
+    public:
+        UsedBytes(std::pmr::memory_resource& upstream, const std::byte* buffer, size_t capacity)
+            : upstream_(upstream)
+            , begin_(reinterpret_cast<uintptr_t>(buffer))
+            , capacity_(capacity) {
+        }
+
+        size_t bytes = 0;
+
+    private:
+        void* do_allocate(size_t size, size_t alignment) override {
+            void* p = upstream_.allocate(size, alignment);
+            const uintptr_t offset = reinterpret_cast<uintptr_t>(p) - begin_;
+            if (offset < capacity_) {
+                bytes = std::max(bytes, offset + size);
+            }
+            return p;
+        }
+
+        void do_deallocate(void* p, size_t size, size_t alignment) override {
+            upstream_.deallocate(p, size, alignment);
+        }
+
+        bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+            return this == &other;
+        }
+
+        std::pmr::memory_resource& upstream_;
+        uintptr_t begin_;
+        size_t capacity_;
+    };
+
+    std::unique_ptr<std::byte, NodeFree> buffer_;
+    std::pmr::monotonic_buffer_resource resource_;
+    UsedBytes used_;
+};
+
+}   // namespace ozma
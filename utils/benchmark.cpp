@@ -1,9 +1,227 @@
 #include "benchmark.h"
 
+#include <algorithm>
+#include <ctime>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
 namespace ozma {
 
 namespace benchmark {
 
+namespace {
+
+struct IntervalLogConfig {
+    std::string dir;
+    int64_t intervalNs = 0;
+    uint64_t intervalCount = 0;
+};
+
+IntervalLogConfig intervalConfig;
+std::mutex intervalLogsMutex;
+std::vector<std::unique_ptr<IntervalLog>> intervalLogs;
+
+// Compressing and writing an interval takes far longer than a measured call: one thread polls
+// every log for intervals handed over, the recording threads never wait for it
+class IntervalLogWriter {
+public:
+    constexpr static auto pollPeriod = std::chrono::milliseconds(1);
+
+    ~IntervalLogWriter() {
+        stop();
+    }
+
+    void start() {
+        if (!thread_.joinable()) {
+            stop_ = false;
+            thread_ = std::thread([this] { run(); });
+        }
+    }
+
+    // Writes what was handed over before returning
+    void stop() {
+        if (thread_.joinable()) {
+            stop_ = true;
+            thread_.join();
+        }
+    }
+
+private:
+    void run() {
+        while (!stop_.load(std::memory_order_relaxed)) {
+            writeAll();
+            std::this_thread::sleep_for(pollPeriod);
+        }
+        writeAll();
+    }
+
+    static void writeAll() {
+        std::lock_guard lock(intervalLogsMutex);
+        for (auto& log : intervalLogs) {
+            log->writePending();
+        }
+    }
+
+    std::atomic<bool> stop_{ false };
+    std::thread thread_;
+};
+
+// Destroyed before the logs it writes
+IntervalLogWriter intervalLogWriter;
+
+hdr_timespec toTimespec(std::chrono::nanoseconds ns) {
+    hdr_timespec ts{};
+    ts.tv_sec = ns.count() / 1'000'000'000;
+    ts.tv_nsec = ns.count() % 1'000'000'000;
+    return ts;
+}
+
+void widen(hdr_histogram*& h, int64_t value) {
+    // Every histogram here starts at 1ns
+    hdr_histogram* wider = nullptr;
+    REQUIRE(
+        hdr_init(
+            1,
+            std::max(2 * value, 2 * h->highest_trackable_value),
+            h->significant_figures,
+            &wider) == 0,
+        "Can't grow histogram to " << value);
+    hdr_add(wider, h);
+    hdr_close(h);
+    h = wider;
+}
+
+}   // namespace
+
+void recordGrowing(hdr_histogram*& h, int64_t value) {
+    if (hdr_record_value(h, value) || value < 0) {
+        return;
+    }
+    widen(h, value);
+    REQUIRE(hdr_record_value(h, value), "Can't record " << value);
+}
+
+void addGrowing(hdr_histogram*& h, const hdr_histogram* from) {
+    if (from->total_count > 0 && hdr_max(from) > h->highest_trackable_value) {
+        widen(h, hdr_max(from));
+    }
+    REQUIRE(hdr_add(h, from) == 0, "Values dropped adding histograms");
+}
+
+IntervalLog::IntervalLog(const std::string& path, int64_t intervalNs, uint64_t intervalCount)
+    : file_(std::fopen(path.c_str(), "w"))
+    , logStart_(TimePoint::clock::now())
+    , start_(logStart_)
+    , intervalNs_(intervalNs)
+    , intervalCount_(intervalCount) {
+    REQUIRE(file_ != nullptr, "Can't write " << path);
+    hdr_histogram* spare = nullptr;
+    REQUIRE(hdr_init(1, 100'000, 3, &interval_) == 0, "Can't create histogram");
+    REQUIRE(hdr_init(1, 100'000, 3, &spare) == 0, "Can't create histogram");
+    spare_.store(spare, std::memory_order_relaxed);
+    hdr_log_writer_init(&writer_);
+    timespec now{};
+    clock_gettime(CLOCK_REALTIME, &now);
+    hdr_timespec startTime{};
+    startTime.tv_sec = now.tv_sec;
+    startTime.tv_nsec = now.tv_nsec;
+    hdr_log_write_header(&writer_, file_, "csv_parser_bench", &startTime);
+}
+
+IntervalLog::~IntervalLog() {
+    hdr_close(interval_);
+    for (hdr_histogram* h : { spare_.load(), full_.load() }) {
+        if (h != nullptr) {
+            hdr_close(h);
+        }
+    }
+    std::fclose(file_);
+}
+
+void IntervalLog::rotate(TimePoint now) {
+    if (interval_->total_count == 0) {
+        count_ = 0;
+        start_ = now;
+        return;
+    }
+    hdr_histogram* spare = spare_.exchange(nullptr, std::memory_order_acquire);
+    if (spare == nullptr) {
+        return;
+    }
+    // The writer is done with the previous interval and its bounds
+    fullBegin_ = start_;
+    fullEnd_ = now;
+    full_.store(interval_, std::memory_order_release);
+    interval_ = spare;
+    count_ = 0;
+    start_ = now;
+}
+
+void IntervalLog::writePending() {
+    hdr_histogram* full = full_.load(std::memory_order_acquire);
+    if (full == nullptr) {
+        return;
+    }
+    write(full, fullBegin_, fullEnd_);
+    hdr_reset(full);
+    full_.store(nullptr, std::memory_order_relaxed);
+    spare_.store(full, std::memory_order_release);
+}
+
+void IntervalLog::writeCurrent(TimePoint now) {
+    if (interval_->total_count > 0) {
+        write(interval_, start_, now);
+        hdr_reset(interval_);
+    }
+    std::fflush(file_);
+    count_ = 0;
+    start_ = now;
+}
+
+void IntervalLog::write(hdr_histogram* h, TimePoint begin, TimePoint end) {
+    // Interval bounds relative to the StartTime of the header
+    const hdr_timespec beginTs = toTimespec(begin - logStart_);
+    const hdr_timespec endTs = toTimespec(end - logStart_);
+    hdr_log_write(&writer_, file_, &beginTs, &endTs, h);
+}
+
+void enableIntervalLog(const std::string& dir, int64_t intervalMs, uint64_t intervalCount) {
+    REQUIRE(intervalMs > 0 || intervalCount > 0, "Interval log needs an interval");
+    std::filesystem::create_directories(dir);
+    intervalConfig = IntervalLogConfig{ dir, intervalMs * 1'000'000, intervalCount };
+    intervalLogWriter.start();
+}
+
+IntervalLog* openIntervalLog(std::string_view benchName) {
+    if (intervalConfig.dir.empty()) {
+        return nullptr;
+    }
+    // ParserType::Custom -> ParserType.Custom.hlog
+    std::string fileName(benchName);
+    if (auto colons = fileName.find("::"); colons != std::string::npos) {
+        fileName.replace(colons, 2, ".");
+    }
+    std::lock_guard lock(intervalLogsMutex);
+    intervalLogs.push_back(std::make_unique<IntervalLog>(
+        intervalConfig.dir + "/" + fileName + ".hlog",
+        intervalConfig.intervalNs,
+        intervalConfig.intervalCount));
+    return intervalLogs.back().get();
+}
+
+void flushIntervalLogs() {
+    intervalLogWriter.stop();
+    std::lock_guard lock(intervalLogsMutex);
+    const auto now = TimePoint::clock::now();
+    for (auto& log : intervalLogs) {
+        log->writePending();
+        log->writeCurrent(now);
+    }
+}
+
 bool hdrPercentilesPrint(
     struct hdr_histogram* h, FILE* stream, int32_t ticksPerHalfDistance, double maxPercentile) {
     const auto headFormat = "%12s %12s %12s %12s\n\n";
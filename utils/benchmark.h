@@ -3,14 +3,17 @@
 #include "common.h"
 
 #include "hdr_histogram/include/hdr/hdr_histogram.h"
+#include "hdr_histogram/include/hdr/hdr_histogram_log.h"
 
 #include <array>
+#include <atomic>
 #include <chrono>
 #include <cstdio>
 #include <cstdlib>
 #include <cstring>
 #include <cmath>
 #include <sstream>
+#include <string>
 
 namespace ozma {
 
@@ -34,12 +37,75 @@ bool hdrPercentilesPrint(
     int32_t ticksPerHalfDistance,
     double maxPercentile = 0.99);
 
+// Records the value, a value above the range replaces the histogram with a wider copy
+void recordGrowing(hdr_histogram*& h, int64_t value);
+// Adds from to h, widening h first if from has values above its range
+void addGrowing(hdr_histogram*& h, const hdr_histogram* from);
+
+// Time-sliced histograms of one benchmark in the HdrHistogram interval log format: an interval
+// ends every intervalNs or every intervalCount values, whichever comes first (0: unused).
+// The recording thread only swaps histograms, a background thread writes the file.
+class IntervalLog {
+public:
+    IntervalLog(const std::string& path, int64_t intervalNs, uint64_t intervalCount);
+    ~IntervalLog();
+
+    IntervalLog(const IntervalLog&) = delete;
+    IntervalLog& operator=(const IntervalLog&) = delete;
+
+    void record(int64_t value, TimePoint now) {
+        recordGrowing(interval_, value);
+        count_++;
+        if ((intervalCount_ > 0 && count_ >= intervalCount_) ||
+            (intervalNs_ > 0 && (now - start_).count() >= intervalNs_)) {
+            rotate(now);
+        }
+    }
+
+    // Hands the current interval to the writer thread and starts the next one. While the writer
+    // still has the previous interval the current one goes on.
+    void rotate(TimePoint now);
+
+    // Writer thread: writes the interval handed over, if any
+    void writePending();
+
+    // Once recording stopped: writes the current interval (if it has values)
+    void writeCurrent(TimePoint now);
+
+private:
+    void write(hdr_histogram* h, TimePoint begin, TimePoint end);
+
+    FILE* file_;
+    hdr_log_writer writer_{};
+    hdr_histogram* interval_ = nullptr;
+    // Reset histogram for the next interval, nullptr while the writer has it
+    std::atomic<hdr_histogram*> spare_{ nullptr };
+    // Interval waiting for the writer and its bounds
+    std::atomic<hdr_histogram*> full_{ nullptr };
+    TimePoint fullBegin_;
+    TimePoint fullEnd_;
+    TimePoint logStart_;
+    TimePoint start_;
+    int64_t intervalNs_;
+    uint64_t intervalCount_;
+    uint64_t count_ = 0;
+};
+
+// Every benchmark initialized afterwards logs its intervals to <dir>/<BenchType>.<BenchName>.hlog
+void enableIntervalLog(const std::string& dir, int64_t intervalMs, uint64_t intervalCount);
+// nullptr if interval logging is off
+IntervalLog* openIntervalLog(std::string_view benchName);
+// Stops the writer thread and writes the last partial intervals
+void flushIntervalLogs();
+
 template <typename BenchType, size_t BenchSize>
 class Benchmark {
 public:
+    // The range grows past 100us when a slower value comes
     static void init(BenchType bench, const char* name) {
         hdr_init(1, 100'000, 3, &histograms[static_cast<size_t>(bench)]);
         benchNames[static_cast<size_t>(bench)] = name;
+        intervalLogs[static_cast<size_t>(bench)] = openIntervalLog(name);
     }
 
     static void start(BenchType bench) {
@@ -47,10 +113,21 @@ public:
     }
 
     static void end(BenchType bench) {
+        const auto now = TimePoint::clock::now();
         const auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(
-                                 TimePoint::clock::now() - measurements[static_cast<size_t>(bench)])
+                                 now - measurements[static_cast<size_t>(bench)])
                                  .count();
-        hdr_record_value(histograms[static_cast<size_t>(bench)], elapsed);
+        recordGrowing(histograms[static_cast<size_t>(bench)], elapsed);
+        if (auto* log = intervalLogs[static_cast<size_t>(bench)]) {
+            log->record(elapsed, now);
+        }
+    }
+
+    static void record(BenchType bench, int64_t value) {
+        recordGrowing(histograms[static_cast<size_t>(bench)], value);
+        if (auto* log = intervalLogs[static_cast<size_t>(bench)]) {
+            log->record(value, TimePoint::clock::now());
+        }
     }
 
     static hdr_histogram* getHist(BenchType bench) {
@@ -78,6 +155,8 @@ private:
     static inline std::array<hdr_histogram*, BenchSize> histograms =
         createArray<hdr_histogram*, BenchSize>(nullptr);
     static inline std::array<std::string_view, BenchSize> benchNames{};
+    static inline std::array<IntervalLog*, BenchSize> intervalLogs =
+        createArray<IntervalLog*, BenchSize>(nullptr);
 };
 
 }   // namespace benchmark
@@ -97,6 +176,22 @@ private:
 #define BENCH_END(BenchType, BenchName)                                                            \
     benchmark::Benchmark<BenchType, BenchType##Size>::end(BenchType::BenchName)
 
+// EnumClass, value, nanoseconds
+// Records a latency measured elsewhere, e.g. from the arrival time of a message
+#define BENCH_RECORD(BenchType, BenchName, Value)                                                  \
+    if (auto stat =                                                                                \
+            benchmark::Benchmark<BenchType, BenchType##Size>::getHist(BenchType::BenchName);       \
+        stat == nullptr) {                                                                         \
+        benchmark::Benchmark<BenchType, BenchType##Size>::init(                                    \
+            BenchType::BenchName, #BenchType "::" #BenchName);                                     \
+    }                                                                                              \
+    benchmark::Benchmark<BenchType, BenchType##Size>::record(BenchType::BenchName, Value)
+
+// EnumClass, value
+// True if anything has been recorded
+#define BENCH_RECORDED(BenchType, BenchName)                                                       \
+    (benchmark::Benchmark<BenchType, BenchType##Size>::getHist(BenchType::BenchName) != nullptr)
+
 // EnumClass, value
 #define BENCH_DISTR(BenchType, BenchName)                                                          \
     benchmark::Benchmark<BenchType, BenchType##Size>::histToStr(BenchType::BenchName)
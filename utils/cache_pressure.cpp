@@ -0,0 +1,98 @@
+#include "cache_pressure.h"
+
+#include <cstring>
+#include <immintrin.h>
+#include <unistd.h>
+
+namespace ozma {
+
+namespace {
+
+size_t defaultThrashBytes() {
+    const long llc = sysconf(_SC_LEVEL3_CACHE_SIZE);
+    return llc > 0 ? 2 * static_cast<size_t>(llc) : 64 << 20;
+}
+
+}   // namespace
+
+CacheMode parseCacheMode(std::string_view mode) {
+    if (mode == "hot") {
+        return CacheMode::Hot;
+    }
+    if (mode == "flush") {
+        return CacheMode::Flush;
+    }
+    if (mode == "thrash") {
+        return CacheMode::Thrash;
+    }
+    REQUIRE(mode == "interleave", "Unknown cache mode: " << mode);
+    return CacheMode::Interleave;
+}
+
+CachePressure::CachePressure(CacheMode mode, size_t thrashBytes, size_t interleaveSteps)
+    : mode_(mode)
+    , steps_(interleaveSteps) {
+    if (mode_ == CacheMode::Thrash || mode_ == CacheMode::Interleave) {
+        size_ = (thrashBytes ? thrashBytes : defaultThrashBytes()) / lineSize * lineSize;
+        REQUIRE(size_ > 0, "Thrash buffer is smaller than a cache line");
+        buffer_ = std::make_unique<std::byte[]>(size_);
+        // fault the pages in now, not in the first measured calls
+        std::memset(buffer_.get(), 1, size_);
+    }
+}
+
+void CachePressure::prepare(
+    const void* message, size_t messageSize, const void* state, size_t stateSize) {
+    switch (mode_) {
+    case CacheMode::Hot:
+        break;
+    case CacheMode::Flush:
+        flush(message, messageSize);
+        flush(state, stateSize);
+        fence();
+        break;
+    case CacheMode::Thrash:
+        thrash();
+        break;
+    case CacheMode::Interleave:
+        interleave();
+        break;
+    }
+}
+
+void CachePressure::flush(const void* data, size_t size) {
+    const auto beg = reinterpret_cast<uintptr_t>(data) & ~(uintptr_t{ lineSize } - 1);
+    const auto end = reinterpret_cast<uintptr_t>(data) + size;
+    for (uintptr_t line = beg; line < end; line += lineSize) {
+        _mm_clflush(reinterpret_cast<const void*>(line));
+    }
+}
+
+void CachePressure::fence() {
+    _mm_mfence();
+}
+
+void CachePressure::thrash() {
+    // Stores: the lines are dirty and have to be written back as well
+    std::byte* buffer = buffer_.get();
+    for (size_t i = 0; i < size_; i += lineSize) {
+        buffer[i] = static_cast<std::byte>(static_cast<uint8_t>(buffer[i]) + 1);
+    }
+    asm volatile("" : : "r"(buffer) : "memory");
+}
+
+void CachePressure::interleave() {
+    const size_t lines = size_ / lineSize;
+    std::byte* buffer = buffer_.get();
+    for (size_t i = 0; i < steps_; i++) {
+        // xorshift64
+        rng_ ^= rng_ << 13;
+        rng_ ^= rng_ >> 7;
+        rng_ ^= rng_ << 17;
+        std::byte& line = buffer[(rng_ % lines) * lineSize];
+        line = static_cast<std::byte>(static_cast<uint8_t>(line) ^ static_cast<uint8_t>(rng_));
+    }
+    asm volatile("" : : "r"(buffer) : "memory");
+}
+
+}   // namespace ozma
@@ -0,0 +1,92 @@
+#pragma once
+
+#include "common.h"
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string_view>
+
+namespace ozma {
+
+// What the cache looks like when a measured call starts
+enum class CacheMode {
+    // Whatever the previous call left: the best case
+    Hot,
+    // Message and parser state flushed from every cache level (clflush), see OwnsBuffers
+    Flush,
+    // A buffer larger than the LLC walked before each call: everything is cold
+    Thrash,
+    // Random accesses over the buffer between calls, like other work done by the core
+    Interleave
+};
+DECLARE_ENUM(CacheMode, 4, Hot, Flush, Thrash, Interleave);
+
+// "hot", "flush", "thrash", "interleave"
+CacheMode parseCacheMode(std::string_view mode);
+
+// State that owns heap memory reports it, the object itself included, as visit(data, size)
+// calls. Flush mode evicts all of it; other states are flushed as their sizeof bytes.
+template <typename State>
+concept OwnsBuffers = requires(const State& state) {
+    state.visitBuffers([](const void*, size_t) {});
+};
+
+class CachePressure {
+public:
+    constexpr static size_t lineSize = 64;
+
+    // thrashBytes 0: twice the LLC size
+    explicit CachePressure(
+        CacheMode mode = CacheMode::Hot,
+        size_t thrashBytes = 0,
+        size_t interleaveSteps = 4096);
+
+    // Called right before a measured call on message with the given parser (or other) state
+    template <typename State>
+    void prepare(std::string_view message, const State& state) {
+        if constexpr (OwnsBuffers<State>) {
+            if (mode_ == CacheMode::Flush) {
+                flush(message.data(), message.size());
+                state.visitBuffers([](const void* data, size_t size) { flush(data, size); });
+                fence();
+                return;
+            }
+        }
+        if (mode_ != CacheMode::Hot) {
+            prepare(message.data(), message.size(), &state, sizeof(State));
+        }
+    }
+
+    // Stateless consumers: only the message is evicted in Flush mode
+    void prepare(std::string_view message) {
+        if (mode_ != CacheMode::Hot) {
+            prepare(message.data(), message.size(), nullptr, 0);
+        }
+    }
+
+    CacheMode mode() const {
+        return mode_;
+    }
+
+    size_t bufferSize() const {
+        return size_;
+    }
+
+private:
+    void prepare(const void* message, size_t messageSize, const void* state, size_t stateSize);
+
+    static void flush(const void* data, size_t size);
+    // Flushes are done before the measured call starts
+    static void fence();
+    void thrash();
+    void interleave();
+
+    CacheMode mode_;
+    size_t size_ = 0;
+    size_t steps_;
+    std::unique_ptr<std::byte[]> buffer_;
+    uint64_t rng_ = 0x9e3779b97f4a7c15;
+};
+
+}   // namespace ozma
@@ -0,0 +1,98 @@
+#pragma once
+
+#include "common.h"
+#include "topology.h"
+
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <memory>
+
+namespace ozma {
+
+// Bounded lock-free single-producer single-consumer ring. Slots are constructed once and
+// reused in place: the producer fills back() (e.g. parses into it) and push()es it, the consumer
+// reads front() and pop()s it. Buffers inside the slots (vectors) are kept between laps, so
+// nothing is allocated or moved once every slot has been used.
+template <typename T>
+class SpscQueue {
+public:
+    // Capacity is rounded up to a power of two.
+    // node: numa node of the consumer thread for the slots, negative: not bound. Only the slots
+    // themselves: buffers inside them come from whatever allocator args give them.
+    // args: passed to the constructor of every slot (e.g. an allocator).
+    template <typename... Args>
+    explicit SpscQueue(size_t capacity, int node = -1, const Args&... args)
+        : capacity_(std::bit_ceil(std::max<size_t>(capacity, 2)))
+        , slots_(
+              static_cast<T*>(allocOnNode(capacity_ * sizeof(T), node)),
+              NodeFree{ capacity_ * sizeof(T) }) {
+        size_t i = 0;
+        try {
+            for (; i < capacity_; i++) {
+                std::construct_at(slots_.get() + i, args...);
+            }
+        } catch (...) {
+            std::destroy_n(slots_.get(), i);
+            throw;
+        }
+    }
+
+    ~SpscQueue() {
+        std::destroy_n(slots_.get(), capacity_);
+    }
+
+    SpscQueue(const SpscQueue&) = delete;
+    SpscQueue& operator=(const SpscQueue&) = delete;
+
+    // Producer: slot to fill, nullptr if the queue is full
+    T* back() {
+        const size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cachedHead_ == capacity_) {
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            if (tail - cachedHead_ == capacity_) {
+                return nullptr;
+            }
+        }
+        return slots_.get() + (tail & (capacity_ - 1));
+    }
+
+    // Producer: publishes the slot returned by back()
+    void push() {
+        tail_.store(tail_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    // Consumer: oldest slot, nullptr if the queue is empty
+    T* front() {
+        const size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cachedTail_) {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (head == cachedTail_) {
+                return nullptr;
+            }
+        }
+        return slots_.get() + (head & (capacity_ - 1));
+    }
+
+    // Consumer: gives the slot returned by front() back to the producer
+    void pop() {
+        head_.store(head_.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    }
+
+    size_t capacity() const {
+        return capacity_;
+    }
+
+private:
+    const size_t capacity_;
+    std::unique_ptr<T, NodeFree> slots_;
+
+    // Each side's index and its cached copy of the other one on their own cache lines
+    alignas(64) std::atomic<size_t> head_{ 0 };
+    size_t cachedTail_ = 0;
+    alignas(64) std::atomic<size_t> tail_{ 0 };
+    size_t cachedHead_ = 0;
+};
+
+}   // namespace ozma
@@ -0,0 +1,211 @@
+#include "topology.h"
+
+#include "common.h"
+#include "logger.h"
+
+#include <charconv>
+#include <filesystem>
+#include <fstream>
+#include <linux/mempolicy.h>
+#include <map>
+#include <sched.h>
+#include <sstream>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace ozma {
+
+namespace {
+
+const std::string SYS_CPU = "/sys/devices/system/cpu";
+const std::string SYS_NODE = "/sys/devices/system/node";
+
+std::string readFirstLine(const std::string& path) {
+    std::ifstream in(path);
+    std::string line;
+    std::getline(in, line);
+    return line;
+}
+
+int readInt(const std::string& path, int fallback) {
+    const auto line = readFirstLine(path);
+    int value = fallback;
+    std::from_chars(line.data(), line.data() + line.size(), value);
+    return value;
+}
+
+constexpr size_t maskBits = sizeof(unsigned long) * 8;
+
+// Node mask for set_mempolicy/mbind, mask.size() * maskBits nodes
+std::vector<unsigned long> nodeMask(int node) {
+    std::vector<unsigned long> mask(node / maskBits + 1, 0);
+    mask[node / maskBits] |= 1UL << (node % maskBits);
+    return mask;
+}
+
+}   // namespace
+
+std::vector<int> parseCpuList(std::string_view list) {
+    std::vector<int> cpus;
+    while (!list.empty()) {
+        const auto comma = list.find(',');
+        const auto range = list.substr(0, comma);
+        list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+        if (range.empty()) {
+            continue;
+        }
+        int first{};
+        auto [ptr, ec] = std::from_chars(range.data(), range.data() + range.size(), first);
+        REQUIRE(ec == std::errc{}, "Bad cpu list: " << range);
+        int last = first;
+        if (ptr != range.data() + range.size()) {
+            REQUIRE(*ptr == '-', "Bad cpu list: " << range);
+            ec = std::from_chars(ptr + 1, range.data() + range.size(), last).ec;
+            REQUIRE(ec == std::errc{} && last >= first, "Bad cpu list: " << range);
+        }
+        for (int cpu = first; cpu <= last; cpu++) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+const CpuTopology& CpuTopology::get() {
+    static const CpuTopology topology;
+    return topology;
+}
+
+CpuTopology::CpuTopology() {
+    auto online = parseCpuList(readFirstLine(SYS_CPU + "/online"));
+    if (online.empty()) {
+        for (int cpu = 0; cpu < static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN)); cpu++) {
+            online.push_back(cpu);
+        }
+    }
+
+    std::map<int, int> cpuNode;
+    std::error_code ec;
+    for (const auto& entry : std::filesystem::directory_iterator(SYS_NODE, ec)) {
+        const auto name = entry.path().filename().string();
+        int node{};
+        if (name.rfind("node", 0) != 0 ||
+            std::from_chars(name.data() + 4, name.data() + name.size(), node).ec != std::errc{}) {
+            continue;
+        }
+        nodes_ = std::max(nodes_, node + 1);
+        for (int cpu : parseCpuList(readFirstLine(entry.path().string() + "/cpulist"))) {
+            cpuNode[cpu] = node;
+        }
+    }
+
+    for (int id : online) {
+        const auto topology = SYS_CPU + "/cpu" + std::to_string(id) + "/topology/";
+        cpus_.push_back(Cpu{
+            id,
+            readInt(topology + "core_id", id),
+            readInt(topology + "physical_package_id", 0),
+            cpuNode.contains(id) ? cpuNode[id] : 0 });
+    }
+}
+
+int CpuTopology::nodeOf(int cpu) const {
+    for (const auto& info : cpus_) {
+        if (info.id == cpu) {
+            return info.node;
+        }
+    }
+    return 0;
+}
+
+std::vector<int> CpuTopology::cpusOfNode(int node) const {
+    std::vector<int> result;
+    for (const auto& info : cpus_) {
+        if (info.node == node) {
+            result.push_back(info.id);
+        }
+    }
+    return result;
+}
+
+std::string CpuTopology::describe() const {
+    std::stringstream ss;
+    ss << cpus_.size() << " cpus, " << nodes_ << " numa nodes";
+    for (int node = 0; node < nodes_; node++) {
+        ss << "; node " << node << ":";
+        for (int cpu : cpusOfNode(node)) {
+            ss << " " << cpu;
+        }
+    }
+    return ss.str();
+}
+
+Placement Placement::parse(std::string_view cpuList, int node) {
+    Placement placement{ parseCpuList(cpuList), node };
+    for (int cpu : placement.cpus) {
+        REQUIRE(cpu >= 0 && cpu < CPU_SETSIZE, "Bad cpu: " << cpu);
+    }
+    return placement;
+}
+
+int Placement::effectiveNode() const {
+    if (node >= 0) {
+        return node;
+    }
+    return cpus.empty() ? -1 : CpuTopology::get().nodeOf(cpus.front());
+}
+
+bool pinThread(pthread_t thread, const std::vector<int>& cpus) {
+    cpu_set_t cpuset;
+    CPU_ZERO(&cpuset);
+    for (int cpu : cpus) {
+        CPU_SET(cpu, &cpuset);
+    }
+    return pthread_setaffinity_np(thread, sizeof(cpu_set_t), &cpuset) == 0;
+}
+
+bool preferNode(int node) {
+    const auto mask = nodeMask(node);
+    return syscall(SYS_set_mempolicy, MPOL_PREFERRED, mask.data(), mask.size() * maskBits + 1) == 0;
+}
+
+void applyPlacement(const Placement& placement, std::string_view threadName) {
+    if (!placement.cpus.empty() && !pinThread(pthread_self(), placement.cpus)) {
+        WARN() << threadName << ": can't pin to the requested cpus, running unpinned";
+    }
+    const int node = placement.effectiveNode();
+    if (node >= 0 && CpuTopology::get().nodes() > 1 && !preferNode(node)) {
+        WARN() << threadName << ": can't prefer memory of numa node " << node;
+    }
+}
+
+bool bindToNode(void* ptr, size_t size, int node) {
+    if (node < 0 || CpuTopology::get().nodes() < 2) {
+        return true;
+    }
+    const auto mask = nodeMask(node);
+    // Pages touched already are moved
+    return syscall(
+               SYS_mbind,
+               ptr,
+               size,
+               MPOL_BIND,
+               mask.data(),
+               mask.size() * maskBits + 1,
+               MPOL_MF_MOVE) == 0;
+}
+
+void* allocOnNode(size_t size, int node) {
+    void* ptr = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    REQUIRE(ptr != MAP_FAILED, "Can't allocate " << size << " bytes");
+    if (!bindToNode(ptr, size, node)) {
+        WARN() << "Can't bind memory to numa node " << node;
+    }
+    return ptr;
+}
+
+void freeOnNode(void* ptr, size_t size) {
+    munmap(ptr, size);
+}
+
+}   // namespace ozma
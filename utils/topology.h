@@ -0,0 +1,111 @@
+#pragma once
+
+#include <cstddef>
+#include <memory_resource>
+#include <pthread.h>
+#include <string>
+#include <string_view>
+#include <vector>
+
+namespace ozma {
+
+// "0-3,8,10-11" -> {0, 1, 2, 3, 8, 10, 11}
+std::vector<int> parseCpuList(std::string_view list);
+
+// Online cpus and numa nodes as seen in /sys/devices/system
+class CpuTopology {
+public:
+    struct Cpu {
+        int id{};
+        int core{};
+        int package{};
+        int node{};
+    };
+
+    // Discovered once
+    static const CpuTopology& get();
+
+    const std::vector<Cpu>& cpus() const {
+        return cpus_;
+    }
+
+    int nodes() const {
+        return nodes_;
+    }
+
+    // 0 if the cpu is unknown or the machine is not numa
+    int nodeOf(int cpu) const;
+    std::vector<int> cpusOfNode(int node) const;
+    std::string describe() const;
+
+private:
+    CpuTopology();
+
+    std::vector<Cpu> cpus_;
+    int nodes_ = 1;
+};
+
+// Where a thread runs and allocates its memory
+struct Placement {
+    // Empty: not pinned
+    std::vector<int> cpus;
+    // Negative: node of the first cpu
+    int node = -1;
+
+    static Placement parse(std::string_view cpuList, int node = -1);
+
+    int effectiveNode() const;
+};
+
+// Both return false if the kernel refused, the caller decides whether it is fatal
+bool pinThread(pthread_t thread, const std::vector<int>& cpus);
+// Memory policy of the calling thread: new pages come from the node when possible
+bool preferNode(int node);
+
+// Pins the calling thread and binds its allocations to the node; warns on refusal
+void applyPlacement(const Placement& placement, std::string_view threadName);
+
+// Binds (and moves) the pages of a mapping to the node, negative node: no-op.
+// False if the kernel refused.
+bool bindToNode(void* ptr, size_t size, int node);
+
+// Page-aligned memory bound to the node (negative: not bound), freeOnNode() releases it
+void* allocOnNode(size_t size, int node);
+void freeOnNode(void* ptr, size_t size);
+
+// Deleter for memory from allocOnNode()
+struct NodeFree {
+    size_t size = 0;
+
+    void operator()(void* ptr) const {
+        freeOnNode(ptr, size);
+    }
+};
+
+// allocOnNode() as a memory resource. Every allocation is a mapping of its own: meant as the
+// upstream of a pool, not for individual small allocations.
+class NodeResource : public std::pmr::memory_resource {
+public:
+    // node: negative: not bound
+    explicit NodeResource(int node = -1)
+        : node_(node) {
+    }
+
+private:
+    // Mappings are page-aligned, more than any alignment asked for here
+    void* do_allocate(size_t size, size_t) override {
+        return allocOnNode(size, node_);
+    }
+
+    void do_deallocate(void* ptr, size_t size, size_t) override {
+        freeOnNode(ptr, size);
+    }
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
+
+    int node_;
+};
+
+}   // namespace ozma
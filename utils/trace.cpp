@@ -0,0 +1,136 @@
+#include "trace.h"
+
+#include "logger.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <memory>
+#include <unistd.h>
+
+namespace ozma {
+
+void Tracer::enable(size_t sampleEvery, size_t capacity) {
+    REQUIRE(sampleEvery > 0, "Trace sampling must be positive");
+    sampleEvery_ = sampleEvery;
+    capacity_ = capacity;
+    startTsc_ = __rdtsc();
+    startTime_ = TimePoint::clock::now();
+    enabled_ = true;
+}
+
+void Tracer::registerThread(const std::string& name) {
+    if (enabled_ && current_ == nullptr) {
+        current_ = addThread(name);
+    }
+}
+
+Tracer::Thread* Tracer::addThread(const std::string& name) {
+    auto thread = std::make_unique<Thread>();
+    thread->tid = static_cast<int>(gettid());
+    thread->name = name.empty() ? "thread " + std::to_string(thread->tid) : name;
+    thread->records.resize(capacity_);
+    std::lock_guard lock(mutex_);
+    threads_.push_back(std::move(thread));
+    return threads_.back().get();
+}
+
+TraceRecord* Tracer::sample(uint64_t row, uint64_t beginTsc) {
+    if (current_ == nullptr) {
+        current_ = addThread("");
+    }
+    Thread& thread = *current_;
+    if (thread.seen++ % sampleEvery_ != 0) {
+        return nullptr;
+    }
+    if (thread.size == thread.records.size()) {
+        thread.dropped++;
+        return nullptr;
+    }
+    TraceRecord& record = thread.records[thread.size++];
+    record = TraceRecord{};
+    record.row = row;
+    record.begin = beginTsc != 0 ? beginTsc : __rdtsc();
+    return &record;
+}
+
+void Tracer::writeChromeTrace(const std::string& path) {
+    // Every thread that recorded has finished by now
+    const uint64_t endTsc = __rdtsc();
+    const double elapsedUs =
+        std::chrono::duration<double, std::micro>(TimePoint::clock::now() - startTime_).count();
+    const double ticksPerUs = elapsedUs > 0 ? (endTsc - startTsc_) / elapsedUs : 1;
+    auto us = [&](uint64_t tsc) { return (tsc - startTsc_) / ticksPerUs; };
+
+    std::unique_ptr<FILE, int (*)(FILE*)> file(std::fopen(path.c_str(), "w"), &std::fclose);
+    REQUIRE(file != nullptr, "Can't write " << path);
+    FILE* out = file.get();
+    std::fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[\n");
+    bool first = true;
+    auto separator = [&] {
+        if (!first) {
+            std::fprintf(out, ",\n");
+        }
+        first = false;
+    };
+
+    std::lock_guard lock(mutex_);
+    size_t records = 0;
+    for (const auto& thread : threads_) {
+        separator();
+        std::fprintf(
+            out,
+            "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,"
+            "\"args\":{\"name\":\"%s\"}}",
+            thread->tid,
+            thread->name.c_str());
+        if (thread->dropped > 0) {
+            WARN() << "Trace buffer of " << thread->name << " was full, " << thread->dropped
+                   << " sampled messages not recorded";
+        }
+        for (size_t i = 0; i < thread->size; i++) {
+            const TraceRecord& record = thread->records[i];
+            const uint64_t last = *std::max_element(record.ends, record.ends + record.stages);
+            if (last == 0) {
+                continue;
+            }
+            // The message, with its stages nested in it
+            separator();
+            std::fprintf(
+                out,
+                "{\"name\":\"row %lu\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+                "\"dur\":%.3f,\"args\":{\"row\":%lu}}",
+                record.row,
+                thread->tid,
+                us(record.begin),
+                (last - record.begin) / ticksPerUs,
+                record.row);
+            uint64_t from = record.begin;
+            for (size_t stage = 0; stage < record.stages; stage++) {
+                if (record.ends[stage] == 0) {
+                    continue;
+                }
+                if (record.begins[stage] != 0) {
+                    from = record.begins[stage];
+                }
+                separator();
+                std::fprintf(
+                    out,
+                    "{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,"
+                    "\"dur\":%.3f,\"args\":{\"row\":%lu}}",
+                    TraceStageStr(static_cast<TraceStage>(stage)).data(),
+                    thread->tid,
+                    us(from),
+                    (record.ends[stage] - from) / ticksPerUs,
+                    record.row);
+                from = record.ends[stage];
+            }
+            records++;
+        }
+    }
+    std::fprintf(out, "\n]}\n");
+    REQUIRE(std::fclose(file.release()) == 0, "Can't write " << path);
+    INFO() << "Trace of " << records << " messages written to " << path;
+}
+
+}   // namespace ozma
@@ -0,0 +1,101 @@
+#pragma once
+
+#include "common.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <x86intrin.h>
+
+namespace ozma {
+
+// Pipeline stages of one message, in order. Wait: blocked on a full queue downstream.
+enum class TraceStage { Read, Wait, Parse, Book, Publish };
+DECLARE_ENUM(TraceStage, 5, Read, Wait, Parse, Book, Publish);
+
+struct TraceRecord {
+    constexpr static size_t stages = TraceStageSize;
+
+    uint64_t row{};
+    // TSC when the message started
+    uint64_t begin{};
+    // TSC at the start of each stage, 0: where the previous stage ended
+    uint64_t begins[stages]{};
+    // TSC at the end of each stage, 0: the stage didn't run
+    uint64_t ends[stages]{};
+};
+
+// Per-message stage timestamps for a timeline of individual messages: every sampled message of
+// a thread gets a record in that thread's preallocated buffer, the buffers are written as a
+// Chrome trace (chrome://tracing, ui.perfetto.dev) at the end of the run.
+class Tracer {
+public:
+    // 1 in sampleEvery messages per thread, capacity records per thread
+    static void enable(size_t sampleEvery, size_t capacity);
+
+    // Preallocates the calling thread's buffer and names it in the trace.
+    // Threads that didn't call it get a buffer at their first sampled message.
+    static void registerThread(const std::string& name);
+
+    // Timestamp for begin() when a row is only known to be a message after reading it:
+    // rows that are not messages don't use up samples and records
+    static uint64_t now() {
+        return enabled_.load(std::memory_order_relaxed) ? __rdtsc() : 0;
+    }
+
+    // Record for the message if it is sampled, nullptr otherwise (or if tracing is off).
+    // beginTsc: from now(), 0: the message starts now.
+    static TraceRecord* begin(uint64_t row, uint64_t beginTsc = 0) {
+        if (!enabled_.load(std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return sample(row, beginTsc);
+    }
+
+    // Stage that doesn't follow the previous one right away: the time in between is not
+    // attributed to any stage
+    static void start(TraceRecord* record, TraceStage stage) {
+        if (record != nullptr) {
+            record->begins[static_cast<size_t>(stage)] = __rdtsc();
+        }
+    }
+
+    // End of the stage
+    static void mark(TraceRecord* record, TraceStage stage) {
+        if (record != nullptr) {
+            record->ends[static_cast<size_t>(stage)] = __rdtsc();
+        }
+    }
+
+    static void writeChromeTrace(const std::string& path);
+
+private:
+    struct Thread {
+        std::string name;
+        int tid = 0;
+        std::vector<TraceRecord> records;
+        size_t size = 0;
+        uint64_t seen = 0;
+        uint64_t dropped = 0;
+    };
+
+    static TraceRecord* sample(uint64_t row, uint64_t beginTsc);
+    static Thread* addThread(const std::string& name);
+
+    static inline std::atomic<bool> enabled_{ false };
+    static inline size_t sampleEvery_ = 1;
+    static inline size_t capacity_ = 0;
+    // For the TSC -> time conversion at the end
+    static inline uint64_t startTsc_ = 0;
+    static inline TimePoint startTime_{};
+
+    static inline std::mutex mutex_;
+    static inline std::vector<std::unique_ptr<Thread>> threads_;
+    static inline thread_local Thread* current_ = nullptr;
+};
+
+}   // namespace ozma